@@ -21,6 +21,7 @@
 #include <sys/shm.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <stdio.h>
@@ -35,6 +36,10 @@
 
 #include "aserver.h"
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
 char *command;
 
 #if __GNUC__ > 2 || (__GNUC__ == 2 && __GNUC_MINOR__ >= 95)
@@ -107,45 +112,99 @@ static int make_inet_socket(int port)
 	return sock;
 }
 
-struct pollfd *pollfds;
-unsigned int pollfds_count = 0;
+/*
+ * An epoll event loop.  The main loop accepts the connections, the
+ * clients are spread over the worker loops when there are any, so that
+ * each client is served by a single thread only.
+ */
 typedef struct waiter waiter_t;
+
+typedef struct loop {
+	int epfd;
+	waiter_t *dead;		/* removed waiters, freed after the round */
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+#endif
+} loop_t;
+
+#define LOOP_EVENTS	64
+#define THREADS_MAX	64
+
+loop_t main_loop;
+loop_t *workers;
+unsigned int workers_count = 0;
+
 typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned short events);
 struct waiter {
 	int fd;
+	loop_t *loop;
 	void *private_data;
 	waiter_handler_t handler;
+	waiter_t *next;
 };
-waiter_t *waiters;
+waiter_t **waiters;
+
+#ifdef HAVE_LIBPTHREAD
+/* protects the client lists and the opening and closing of devices */
+static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define clients_lock()		pthread_mutex_lock(&clients_mutex)
+#define clients_unlock()	pthread_mutex_unlock(&clients_mutex)
+/* protects waiters[], the main loop adds while the workers remove */
+static pthread_mutex_t waiters_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define waiters_lock()		pthread_mutex_lock(&waiters_mutex)
+#define waiters_unlock()	pthread_mutex_unlock(&waiters_mutex)
+#else
+#define clients_lock()		do { } while (0)
+#define clients_unlock()	do { } while (0)
+#define waiters_lock()		do { } while (0)
+#define waiters_unlock()	do { } while (0)
+#endif
 
-static void add_waiter(int fd, unsigned short events, waiter_handler_t handler,
-		void *data)
+/*
+ * Each registration gets its own waiter, which is what epoll passes
+ * back.  A removed waiter stays allocated until its loop finished the
+ * current round, so an event already fetched for it is seen as stale
+ * even when the fd was closed and reused for another client meanwhile.
+ * A waiter is removed only from the thread of its own loop.  The poll
+ * events are passed to epoll as they are, the values match.
+ */
+static void add_waiter(loop_t *loop, int fd, unsigned short events,
+		       waiter_handler_t handler, void *data)
 {
-	waiter_t *w = &waiters[fd];
-	struct pollfd *pfd = &pollfds[pollfds_count];
-	assert(!w->handler);
-	pfd->fd = fd;
-	pfd->events = events;
-	pfd->revents = 0;
+	waiter_t *w = calloc(1, sizeof(*w));
+	struct epoll_event ev;
+	if (!w) {
+		ERROR("cannot allocate waiter");
+		exit(1);
+	}
 	w->fd = fd;
+	w->loop = loop;
 	w->private_data = data;
 	w->handler = handler;
-	pollfds_count++;
+	waiters_lock();
+	assert(!waiters[fd]);
+	waiters[fd] = w;
+	waiters_unlock();
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = w;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		SYSERROR("epoll_ctl add failed");
 }
 
 static void del_waiter(int fd)
 {
-	waiter_t *w = &waiters[fd];
-	unsigned int k;
-	assert(w->handler);
+	waiter_t *w;
+	waiters_lock();
+	w = waiters[fd];
+	waiters[fd] = NULL;
+	waiters_unlock();
+	assert(w && w->handler);
 	w->handler = 0;
-	for (k = 0; k < pollfds_count; ++k) {
-		if (pollfds[k].fd == fd)
-			break;
-	}
-	assert(k < pollfds_count);
-	pollfds_count--;
-	memmove(&pollfds[k], &pollfds[k + 1], pollfds_count - k);
+	if (epoll_ctl(w->loop->epfd, EPOLL_CTL_DEL, fd, NULL) < 0)
+		SYSERROR("epoll_ctl del failed");
+	w->next = w->loop->dead;
+	w->loop->dead = w;
 }
 
 typedef struct client client_t;
@@ -158,6 +217,7 @@ typedef struct {
 
 struct client {
 	struct list_head list;
+	loop_t *loop;
 	int poll_fd;
 	int ctrl_fd;
 	int local;
@@ -214,6 +274,23 @@ typedef struct {
 } inet_pending_t;
 LIST_HEAD(inet_pendings);
 
+static void client_close(client_t *client)
+{
+	clients_lock();
+	client->ops->close(client);
+	clients_unlock();
+}
+
+/* the loop serving a new client, the workers are used round robin */
+static loop_t *client_loop(void)
+{
+	static unsigned int next;
+	if (!workers_count)
+		return &main_loop;
+	next = (next + 1) % workers_count;
+	return &workers[next];
+}
+
 #if 0
 static int pcm_handler(waiter_t *waiter, unsigned short events)
 {
@@ -307,6 +384,7 @@ static int pcm_shm_open(client_t *client, int *cookie)
 		SYSERROR("shmat failed");
 		goto _err;
 	}
+	((snd_pcm_shm_ctrl_t *)client->transport.shm.ctrl)->status.tstamp_result = -EIO;
 	*cookie = shmid;
 	return 0;
 
@@ -385,6 +463,25 @@ static void async_handler(snd_async_handler_t *handler)
 	kill(client->async_pid, client->async_sig);
 }
 
+/*
+ * Publish the state, avail and timestamp after the pointers were synced,
+ * the client answers its next queries from them without a round trip.
+ */
+static void pcm_shm_update_status(client_t *client, snd_pcm_sframes_t avail)
+{
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_uframes_t tstamp_avail;
+	snd_htimestamp_t tstamp;
+
+	ctrl->status.avail = avail;
+	ctrl->status.state = snd_pcm_state(pcm);
+	ctrl->status.tstamp_result = snd_pcm_htimestamp(pcm, &tstamp_avail, &tstamp);
+	ctrl->status.tstamp_avail = tstamp_avail;
+	ctrl->status.tstamp.tv_sec = tstamp.tv_sec;
+	ctrl->status.tstamp.tv_nsec = tstamp.tv_nsec;
+}
+
 static int pcm_shm_cmd(client_t *client)
 {
 	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
@@ -439,11 +536,19 @@ static int pcm_shm_cmd(client_t *client)
 	case SND_PCM_IOCTL_HWSYNC:
 		ctrl->result = snd_pcm_hwsync(pcm);
 		break;
+	case SND_PCM_IOCTL_SYNC_STATUS:
+		/* the queries at the top of a transfer iteration at once */
+		ctrl->result = 0;
+		if (snd_pcm_state(pcm) == SND_PCM_STATE_RUNNING)
+			ctrl->result = snd_pcm_hwsync(pcm);
+		pcm_shm_update_status(client, snd_pcm_avail_update(pcm));
+		break;
 	case SNDRV_PCM_IOCTL_DELAY:
 		ctrl->result = snd_pcm_delay(pcm, (snd_pcm_sframes_t *) &ctrl->u.delay.frames);
 		break;
 	case SND_PCM_IOCTL_AVAIL_UPDATE:
 		ctrl->result = snd_pcm_avail_update(pcm);
+		pcm_shm_update_status(client, ctrl->result);
 		break;
 	case SNDRV_PCM_IOCTL_PREPARE:
 		ctrl->result = snd_pcm_prepare(pcm);
@@ -500,12 +605,14 @@ static int pcm_shm_cmd(client_t *client)
 		ctrl->result = snd_pcm_mmap_commit(pcm,
 						   ctrl->u.mmap_commit.offset,
 						   ctrl->u.mmap_commit.frames);
+		if (ctrl->result >= 0)
+			pcm_shm_update_status(client, snd_pcm_avail_update(pcm));
 		break;
 	case SND_PCM_IOCTL_POLL_DESCRIPTOR:
 		ctrl->result = 0;
 		return shm_ack_fd(client, _snd_pcm_poll_descriptor(pcm));
 	case SND_PCM_IOCTL_CLOSE:
-		client->ops->close(client);
+		client_close(client);
 		break;
 	case SND_PCM_IOCTL_HW_PTR_FD:
 		return shm_rbptr_fd(client, &pcm->hw);
@@ -568,7 +675,7 @@ static int ctl_shm_open(client_t *client, int *cookie)
 		goto _err;
 	}
 	*cookie = shmid;
-	add_waiter(client->device.ctl.fd, POLLIN, ctl_handler, client);
+	add_waiter(client->loop, client->device.ctl.fd, POLLIN, ctl_handler, client);
 	client->polling = 1;
 	return 0;
 
@@ -700,7 +807,7 @@ static int ctl_shm_cmd(client_t *client)
 		ctrl->result = snd_ctl_read(ctl, &ctrl->u.read);
 		break;
 	case SND_CTL_IOCTL_CLOSE:
-		client->ops->close(client);
+		client_close(client);
 		break;
 	case SND_CTL_IOCTL_POLL_DESCRIPTOR:
 		ctrl->result = 0;
@@ -775,7 +882,9 @@ static int snd_client_open(client_t *client)
 	client->stream = req.stream;
 	client->mode = req.mode;
 
+	clients_lock();
 	err = client->ops->open(client, &ans.cookie);
+	clients_unlock();
 	if (err < 0) {
 		ans.result = err;
 	} else {
@@ -796,12 +905,14 @@ static int client_poll_handler(waiter_t *waiter, unsigned short events ATTRIBUTE
 {
 	client_t *client = waiter->private_data;
 	if (client->open)
-		client->ops->close(client);
-	close(client->poll_fd);
-	close(client->ctrl_fd);
+		client_close(client);
 	del_waiter(client->poll_fd);
 	del_waiter(client->ctrl_fd);
+	close(client->poll_fd);
+	close(client->ctrl_fd);
+	clients_lock();
 	list_del(&client->list);
+	clients_unlock();
 	free(client);
 	return 0;
 }
@@ -811,10 +922,12 @@ static int client_ctrl_handler(waiter_t *waiter, unsigned short events)
 	client_t *client = waiter->private_data;
 	if (events & POLLHUP) {
 		if (client->open)
-			client->ops->close(client);
-		close(client->ctrl_fd);
+			client_close(client);
 		del_waiter(client->ctrl_fd);
+		close(client->ctrl_fd);
+		clients_lock();
 		list_del(&client->list);
+		clients_unlock();
 		free(client);
 		return 0;
 	}
@@ -863,12 +976,15 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
  found:
 	client = calloc(1, sizeof(*client));
 	client->local = 0;
+	client->loop = client_loop();
 	client->poll_fd = pdata->fd;
 	client->ctrl_fd = waiter->fd;
-	add_waiter(client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
-	add_waiter(client->poll_fd, POLLHUP, client_poll_handler, client);
 	client->open = 0;
+	clients_lock();
 	list_add_tail(&client->list, &clients);
+	clients_unlock();
+	add_waiter(client->loop, client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
+	add_waiter(client->loop, client->poll_fd, POLLHUP, client_poll_handler, client);
 	list_del(&pending->list);
 	list_del(&pdata->list);
 	free(pending);
@@ -888,9 +1004,12 @@ static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSE
 		client_t *client = calloc(1, sizeof(*client));
 		client->ctrl_fd = sock;
 		client->local = 1;
+		client->loop = client_loop();
 		client->open = 0;
-		add_waiter(sock, POLLIN | POLLHUP, client_ctrl_handler, client);
+		clients_lock();
 		list_add_tail(&client->list, &clients);
+		clients_unlock();
+		add_waiter(client->loop, sock, POLLIN | POLLHUP, client_ctrl_handler, client);
 	}
 	return 0;
 }
@@ -907,16 +1026,79 @@ static int inet_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED
 		inet_pending_t *pending = calloc(1, sizeof(*pending));
 		pending->fd = sock;
 		pending->cookie = 0;
-		add_waiter(sock, POLLIN, inet_pending_handler, pending);
+		add_waiter(&main_loop, sock, POLLIN, inet_pending_handler, pending);
 		list_add_tail(&pending->list, &inet_pendings);
 	}
 	return 0;
 }
 
-static int server(const char *sockname, int port)
+static void *loop_run(void *data)
 {
-	int err;
+	loop_t *loop = data;
+	struct epoll_event events[LOOP_EVENTS];
+	int k, err;
+
+	while (1) {
+		err = epoll_wait(loop->epfd, events, LOOP_EVENTS, -1);
+		if (err < 0) {
+			if (errno != EINTR)
+				SYSERROR("epoll_wait failed");
+			continue;
+		}
+		for (k = 0; k < err; k++) {
+			waiter_t *w = events[k].data.ptr;
+			/* removed by a previous handler of this round */
+			if (!w->handler)
+				continue;
+			if (w->handler(w, events[k].events) < 0)
+				ERROR("waiter handler failed");
+		}
+		while (loop->dead) {
+			waiter_t *w = loop->dead;
+			loop->dead = w->next;
+			free(w);
+		}
+	}
+	return NULL;
+}
+
+static int start_workers(unsigned int count)
+{
+#ifdef HAVE_LIBPTHREAD
 	unsigned int k;
+	int result;
+
+	if (!count)
+		return 0;
+	workers = calloc(count, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+	for (k = 0; k < count; k++) {
+		workers[k].epfd = epoll_create(LOOP_EVENTS);
+		if (workers[k].epfd < 0) {
+			result = -errno;
+			SYSERROR("epoll_create failed");
+			return result;
+		}
+		result = pthread_create(&workers[k].thread, NULL, loop_run, &workers[k]);
+		if (result) {
+			ERROR("pthread_create failed: %s", strerror(result));
+			close(workers[k].epfd);
+			return -result;
+		}
+		workers_count++;
+	}
+	return 0;
+#else
+	if (!count)
+		return 0;
+	ERROR("worker threads are not supported");
+	return -ENOSYS;
+#endif
+}
+
+static int server(const char *sockname, int port, unsigned int threads)
+{
 	long open_max;
 	int result;
 
@@ -928,8 +1110,18 @@ static int server(const char *sockname, int port)
 		SYSERROR("sysconf failed");
 		return result;
 	}
-	pollfds = calloc((size_t) open_max, sizeof(*pollfds));
 	waiters = calloc((size_t) open_max, sizeof(*waiters));
+	if (!waiters)
+		return -ENOMEM;
+	main_loop.epfd = epoll_create(LOOP_EVENTS);
+	if (main_loop.epfd < 0) {
+		result = -errno;
+		SYSERROR("epoll_create failed");
+		goto _end;
+	}
+	result = start_workers(threads);
+	if (result < 0)
+		goto _end;
 
 	if (sockname) {
 		int sock = make_local_socket(sockname);
@@ -945,7 +1137,7 @@ static int server(const char *sockname, int port)
 			SYSERROR("listen failed");
 			goto _end;
 		}
-		add_waiter(sock, POLLIN, local_handler, NULL);
+		add_waiter(&main_loop, sock, POLLIN, local_handler, NULL);
 	}
 	if (port >= 0) {
 		int sock = make_inet_socket(port);
@@ -961,36 +1153,13 @@ static int server(const char *sockname, int port)
 			SYSERROR("listen failed");
 			goto _end;
 		}
-		add_waiter(sock, POLLIN, inet_handler, NULL);
+		add_waiter(&main_loop, sock, POLLIN, inet_handler, NULL);
 	}
 
-	while (1) {
-		struct pollfd pfds[open_max];
-		size_t pfds_count;
-		do {
-			err = poll(pollfds, pollfds_count, -1);
-		} while (err == 0);
-		if (err < 0) {
-			SYSERROR("poll failed");
-			continue;
-		}
-
-		pfds_count = pollfds_count;
-		memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
-		for (k = 0; k < pfds_count; k++) {
-			struct pollfd *pfd = &pfds[k];
-			if (pfd->revents) {
-				waiter_t *w = &waiters[pfd->fd];
-				if (!w->handler)
-					continue;
-				err = w->handler(w, pfd->revents);
-				if (err < 0)
-					ERROR("waiter handler failed");
-			}
-		}
-	}
+	loop_run(&main_loop);
  _end:
-	free(pollfds);
+	if (main_loop.epfd >= 0)
+		close(main_loop.epfd);
 	free(waiters);
 	return result;
 }
@@ -1000,7 +1169,8 @@ static void usage(void)
 {
 	fprintf(stderr,
 		"Usage: %s [OPTIONS] server\n"
-		"--help			help\n",
+		"--help			help\n"
+		"--threads=N		serve the clients from N worker threads\n",
 		command);
 }
 
@@ -1008,6 +1178,7 @@ int main(int argc, char **argv)
 {
 	static const struct option long_options[] = {
 		{"help", 0, 0, 'h'},
+		{"threads", 1, 0, 't'},
 		{ 0 , 0 , 0, 0 }
 	};
 	int c;
@@ -1016,14 +1187,29 @@ int main(int argc, char **argv)
 	const char *sockname = NULL;
 	long port = -1;
 	int err;
+	int threads = 0;
 	char *srvname;
 
 	command = argv[0];
-	while ((c = getopt_long(argc, argv, "h", long_options, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, "ht:", long_options, 0)) != -1) {
 		switch (c) {
 		case 'h':
 			usage();
 			return 0;
+		case 't': {
+			char *end;
+			long val;
+			errno = 0;
+			val = strtol(optarg, &end, 0);
+			if (errno || end == optarg || *end ||
+			    val <= 0 || val > THREADS_MAX) {
+				ERROR("invalid number of threads %s (1-%d)",
+				      optarg, THREADS_MAX);
+				return 1;
+			}
+			threads = val;
+			break;
+		}
 		default:
 			fprintf(stderr, "Try `%s --help' for more information\n", command);
 			return 1;
@@ -1080,6 +1266,6 @@ int main(int argc, char **argv)
 		ERROR("either socket or port need to be defined");
 		return 1;
 	}
-	server(sockname, port);
+	server(sockname, port, threads);
 	return 0;
 }
@@ -50,6 +50,7 @@ typedef enum _snd_transport_type {
 #define SND_PCM_IOCTL_HW_PTR_FD		_IO ('A', 0xf9)
 #define SND_PCM_IOCTL_APPL_PTR_FD	_IO ('A', 0xfa)
 #define SND_PCM_IOCTL_FORWARD		_IO ('A', 0xfb)
+#define SND_PCM_IOCTL_SYNC_STATUS	_IO ('A', 0xfc)
 
 typedef struct {
 	snd_pcm_uframes_t ptr;
@@ -58,6 +59,15 @@ typedef struct {
 	int changed;
 } snd_pcm_shm_rbptr_t;
 
+/* refreshed by the server on mmap_commit, avail_update and sync_status */
+typedef struct {
+	int state;
+	snd_pcm_sframes_t avail;
+	int tstamp_result;
+	snd_pcm_uframes_t tstamp_avail;
+	snd_htimestamp_t tstamp;
+} snd_pcm_shm_status_t;
+
 typedef struct {
 	long result;
 	int cmd;
@@ -102,6 +112,9 @@ typedef struct {
 			off_t offset;
 		} rbptr;
 	} u;
+	/* appended, so the fields above keep their offsets for the older
+	 * peers; the clients use it only when the segment holds it */
+	snd_pcm_shm_status_t status;
 	char data[0];
 } snd_pcm_shm_ctrl_t;
 
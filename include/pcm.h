@@ -65,6 +65,8 @@ typedef struct _snd_pcm_hw_params snd_pcm_hw_params_t;
 typedef struct _snd_pcm_sw_params snd_pcm_sw_params_t;
 /** PCM status container */
  typedef struct _snd_pcm_status snd_pcm_status_t;
+/** PCM transfer statistics container, see #snd_pcm_get_stats() */
+typedef struct _snd_pcm_stats snd_pcm_stats_t;
 /** PCM access types mask */
 typedef struct _snd_pcm_access_mask snd_pcm_access_mask_t;
 /** PCM formats mask */
@@ -518,6 +520,8 @@ snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t
 snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size);
 int snd_pcm_wait(snd_pcm_t *pcm, int timeout);
+int snd_pcm_get_stats(snd_pcm_t *pcm, snd_pcm_stats_t *stats);
+int snd_pcm_reset_stats(snd_pcm_t *pcm);
 
 int snd_pcm_link(snd_pcm_t *pcm1, snd_pcm_t *pcm2);
 int snd_pcm_unlink(snd_pcm_t *pcm);
@@ -1032,6 +1036,31 @@ snd_pcm_uframes_t snd_pcm_status_get_overrange(const snd_pcm_status_t *obj);
 
 /** \} */
 
+/**
+ * \defgroup PCM_Stats Transfer Statistics Functions
+ * \ingroup PCM
+ * See the \ref pcm page for more details.
+ * \{
+ */
+
+size_t snd_pcm_stats_sizeof(void);
+/** \hideinitializer
+ * \brief allocate an invalid #snd_pcm_stats_t using standard alloca
+ * \param ptr returned pointer
+ */
+#define snd_pcm_stats_alloca(ptr) __snd_alloca(ptr, snd_pcm_stats)
+int snd_pcm_stats_malloc(snd_pcm_stats_t **ptr);
+void snd_pcm_stats_free(snd_pcm_stats_t *obj);
+void snd_pcm_stats_copy(snd_pcm_stats_t *dst, const snd_pcm_stats_t *src);
+unsigned long long snd_pcm_stats_get_calls(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_frames(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_total_ns(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_self_ns(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_max_ns(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_cpu_ns(const snd_pcm_stats_t *obj);
+
+/** \} */
+
 /**
  * \defgroup PCM_Description Description Functions
  * \ingroup PCM
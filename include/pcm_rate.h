@@ -38,7 +38,7 @@ extern "C" {
 /**
  * Protocol version
  */
-#define SND_PCM_RATE_PLUGIN_VERSION	0x010002
+#define SND_PCM_RATE_PLUGIN_VERSION	0x010003
 
 /** hw_params information for a single side */
 typedef struct snd_pcm_rate_side_info {
@@ -114,6 +114,14 @@ typedef struct snd_pcm_rate_ops {
 	 * new ops since version 0x010002
 	 */
 	void (*dump)(void *obj, snd_output_t *out);
+	/**
+	 * return the bitmasks (1ULL << format) of the input and output
+	 * formats the convert callback processes directly; optional,
+	 * all linear formats are assumed when not given;
+	 * new ops since version 0x010003
+	 */
+	int (*get_supported_formats)(void *obj, u_int64_t *in_formats,
+				     u_int64_t *out_formats);
 } snd_pcm_rate_ops_t;
 
 /** open function type */
@@ -420,6 +420,8 @@ beginning:</P>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <locale.h>
+#include <stdint.h>
+#include <sys/mman.h>
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -443,11 +445,26 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			int join;
+			unsigned int count;
+			struct config_index *index;
 		} compound;
 	} u;
 	struct list_head list;
 	snd_config_t *parent;
 	int hop;
+	unsigned int hash;		/* hash of id, valid in an indexed parent */
+	snd_config_t *hash_next;
+	struct config_arena *arena;	/* the node is allocated from this arena */
+	unsigned int arena_id: 1;	/* id is allocated from the arena */
+	unsigned int arena_string: 1;	/* string is allocated from the arena */
+};
+
+/* compounds with at least this many children get a hash index */
+#define CONFIG_INDEX_MIN	16
+
+struct config_index {
+	unsigned int mask;
+	snd_config_t *buckets[0];
 };
 
 struct filedesc {
@@ -464,10 +481,27 @@ struct filedesc {
 #define LOCAL_UNEXPECTED_CHAR		(LOCAL_ERROR - 2)
 #define LOCAL_UNEXPECTED_EOF		(LOCAL_ERROR - 3)
 
+/* token markers in the binary cache stream, see config_file_load() */
+#define CACHE_TOKEN_STRING	0x01	/* free string follows */
+#define CACHE_TOKEN_QSTRING	0x02	/* quoted string follows */
+
+struct cache_rec {
+	unsigned char *buf;		/* token stream */
+	size_t len, alloc;
+	unsigned char *deps;		/* struct cache_dep records */
+	size_t deps_len;
+	unsigned int ndeps;
+	int failed;
+};
+
 typedef struct {
 	struct filedesc *current;
 	int unget;
 	int ch;
+	struct cache_rec *rec;		/* tokens are recorded here */
+	const unsigned char *replay;	/* tokens are replayed from here */
+	const unsigned char *replay_end;
+	int modes;			/* an explicit '-', '?' or '!' mode was parsed */
 } input_t;
 
 #ifdef HAVE_LIBPTHREAD
@@ -575,6 +609,98 @@ static int safe_strtod(const char *str, double *val)
 	return 0;
 }
 
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t ndeps;			/* count of cache_dep records */
+	uint64_t size;			/* length of the token stream */
+};
+
+struct cache_dep {
+	uint64_t dev;
+	uint64_t ino;
+	int64_t mtime;
+	int64_t ctime;
+	int64_t size;
+	uint32_t len;			/* length of the file name */
+	uint32_t reserved;
+	/* the file name follows, padded to 8 bytes */
+};
+
+#define CACHE_MAGIC		"ALSACFC"
+#define CACHE_VERSION		1
+#define CACHE_DEP_SIZE(len)	(sizeof(struct cache_dep) + (((len) + 7) & ~7))
+
+static void cache_dep_fill(struct cache_dep *dep, const struct stat *st, size_t len)
+{
+	memset(dep, 0, sizeof(*dep));
+	dep->dev = st->st_dev;
+	dep->ino = st->st_ino;
+	dep->mtime = st->st_mtime;
+	dep->ctime = st->st_ctime;
+	dep->size = st->st_size;
+	dep->len = len;
+}
+
+static void cache_rec_put(struct cache_rec *rec, const void *data, size_t len)
+{
+	if (rec->failed)
+		return;
+	if (rec->len + len > rec->alloc) {
+		size_t nalloc = rec->alloc ? rec->alloc : 4096;
+		unsigned char *ptr;
+		while (nalloc < rec->len + len)
+			nalloc *= 2;
+		ptr = realloc(rec->buf, nalloc);
+		if (ptr == NULL) {
+			rec->failed = 1;
+			return;
+		}
+		rec->buf = ptr;
+		rec->alloc = nalloc;
+	}
+	memcpy(rec->buf + rec->len, data, len);
+	rec->len += len;
+}
+
+static void cache_rec_string(struct cache_rec *rec, const char *str, int quoted)
+{
+	unsigned char tok = quoted ? CACHE_TOKEN_QSTRING : CACHE_TOKEN_STRING;
+	uint32_t len = strlen(str);
+
+	cache_rec_put(rec, &tok, 1);
+	cache_rec_put(rec, &len, sizeof(len));
+	cache_rec_put(rec, str, len);
+}
+
+static void cache_rec_dep(struct cache_rec *rec, const char *name)
+{
+	struct cache_dep dep;
+	struct stat st;
+	size_t len = strlen(name);
+	unsigned char *ptr;
+
+	if (rec->failed)
+		return;
+	if (stat(name, &st) < 0) {
+		rec->failed = 1;
+		return;
+	}
+	ptr = realloc(rec->deps, rec->deps_len + CACHE_DEP_SIZE(len));
+	if (ptr == NULL) {
+		rec->failed = 1;
+		return;
+	}
+	rec->deps = ptr;
+	ptr += rec->deps_len;
+	memset(ptr, 0, CACHE_DEP_SIZE(len));
+	cache_dep_fill(&dep, &st, len);
+	memcpy(ptr, &dep, sizeof(dep));
+	memcpy(ptr + sizeof(dep), name, len);
+	rec->deps_len += CACHE_DEP_SIZE(len);
+	rec->ndeps++;
+}
+
 static int get_char(input_t *input)
 {
 	int c;
@@ -583,6 +709,11 @@ static int get_char(input_t *input)
 		input->unget = 0;
 		return input->ch;
 	}
+	if (input->replay) {
+		if (input->replay >= input->replay_end)
+			return LOCAL_UNEXPECTED_EOF;
+		return *input->replay++;
+	}
  again:
 	fd = input->current;
 	c = snd_input_getc(fd->in);
@@ -658,6 +789,8 @@ static int get_char_skip_comments(input_t *input)
 			fd->line = 1;
 			fd->column = 0;
 			input->current = fd;
+			if (input->rec)
+				cache_rec_dep(input->rec, str);
 			continue;
 		}
 		if (c != '#')
@@ -688,11 +821,23 @@ static int get_nonwhite(input_t *input)
 		case '\r':
 			break;
 		default:
+			if (input->rec && c >= 0) {
+				unsigned char tok = c;
+				cache_rec_put(input->rec, &tok, 1);
+			}
 			return c;
 		}
 	}
 }
 
+/* push back a character returned by get_nonwhite() */
+static void unget_nonwhite(int c, input_t *input)
+{
+	unget_char(c, input);
+	if (input->rec && !input->rec->failed && c >= 0)
+		input->rec->len--;
+}
+
 static int get_quotedchar(input_t *input)
 {
 	int c;
@@ -874,12 +1019,37 @@ static int get_delimstring(char **string, int delim, input_t *input)
 	 return c;
 }
 
+static int get_replay_string(char **string, int c, input_t *input)
+{
+	uint32_t len;
+
+	if (c != CACHE_TOKEN_STRING && c != CACHE_TOKEN_QSTRING)
+		return LOCAL_UNEXPECTED_CHAR;
+	if ((size_t)(input->replay_end - input->replay) < sizeof(len))
+		return LOCAL_UNEXPECTED_EOF;
+	memcpy(&len, input->replay, sizeof(len));
+	input->replay += sizeof(len);
+	if ((size_t)(input->replay_end - input->replay) < len)
+		return LOCAL_UNEXPECTED_EOF;
+	*string = malloc(len + 1);
+	if (*string == NULL)
+		return -ENOMEM;
+	memcpy(*string, input->replay, len);
+	(*string)[len] = '\0';
+	input->replay += len;
+	return c == CACHE_TOKEN_QSTRING;
+}
+
 /* Return 0 for free string, 1 for delimited string */
 static int get_string(char **string, int id, input_t *input)
 {
 	int c = get_nonwhite(input), err;
 	if (c < 0)
 		return c;
+	if (input->replay)
+		return get_replay_string(string, c, input);
+	if (input->rec && !input->rec->failed)
+		input->rec->len--;
 	switch (c) {
 	case '=':
 	case ',':
@@ -896,23 +1066,153 @@ static int get_string(char **string, int id, input_t *input)
 		err = get_delimstring(string, c, input);
 		if (err < 0)
 			return err;
+		if (input->rec)
+			cache_rec_string(input->rec, *string, 1);
 		return 1;
 	default:
 		unget_char(c, input);
 		err = get_freestring(string, id, input);
 		if (err < 0)
 			return err;
+		if (input->rec)
+			cache_rec_string(input->rec, *string, 0);
 		return 0;
 	}
 }
 
-static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+/*
+ * Arena allocation of whole trees
+ *
+ * Copies, expanded definitions and the global tree allocate their nodes
+ * (and the ids and strings of copied nodes) from an arena of chunks.
+ * Freeing such a node only drops the reference it holds on the arena;
+ * the chunks are released at once when the last node is deleted.  New
+ * values stored in an arena node are allocated from its arena as well,
+ * so the memory of replaced values is reclaimed with the whole arena.
+ */
+
+struct config_arena_chunk {
+	struct config_arena_chunk *next;
+};
+
+struct config_arena {
+	unsigned int refs;		/* live nodes + the builder */
+	size_t chunk_size;
+	char *ptr, *end;
+	struct config_arena_chunk *chunks;
+	/* the first chunk follows */
+};
+
+#define CONFIG_ARENA_CHUNK	1024
+#define CONFIG_ARENA_CHUNK_MAX	32768
+#define CONFIG_ARENA_ALIGN	16
+
+static struct config_arena *config_arena_new(void)
+{
+	struct config_arena *arena = malloc(sizeof(*arena) + CONFIG_ARENA_CHUNK);
+
+	if (arena) {
+		arena->refs = 1;
+		arena->chunk_size = CONFIG_ARENA_CHUNK * 2;
+		arena->ptr = (char *)(arena + 1);
+		arena->end = arena->ptr + CONFIG_ARENA_CHUNK;
+		arena->chunks = NULL;
+	}
+	return arena;
+}
+
+static void config_arena_unref(struct config_arena *arena)
+{
+	struct config_arena_chunk *c, *next;
+
+	if (--arena->refs > 0)
+		return;
+	for (c = arena->chunks; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+	free(arena);
+}
+
+static void *config_arena_alloc(struct config_arena *arena, size_t size,
+				size_t align)
+{
+	char *p = (char *)(((uintptr_t)arena->ptr + align - 1) & ~(align - 1));
+
+	if (p + size > arena->end) {
+		struct config_arena_chunk *c;
+		size_t csize = arena->chunk_size;
+
+		while (csize < size + CONFIG_ARENA_ALIGN)
+			csize *= 2;
+		c = malloc(csize);
+		if (!c)
+			return NULL;
+		c->next = arena->chunks;
+		arena->chunks = c;
+		p = (char *)c + CONFIG_ARENA_ALIGN;
+		arena->end = (char *)c + csize;
+		if (arena->chunk_size < CONFIG_ARENA_CHUNK_MAX)
+			arena->chunk_size *= 2;
+	}
+	arena->ptr = p + size;
+	return p;
+}
+
+static char *config_arena_strdup(struct config_arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *p = config_arena_alloc(arena, len, 1);
+
+	if (p)
+		memcpy(p, str, len);
+	return p;
+}
+
+/* duplicate a string for storing it in the node n */
+static char *config_strdup(snd_config_t *n, const char *str)
+{
+	if (n->arena)
+		return config_arena_strdup(n->arena, str);
+	return strdup(str);
+}
+
+static void config_free_id(snd_config_t *n)
+{
+	if (!n->arena_id)
+		free(n->id);
+}
+
+static void config_free_string(snd_config_t *n)
+{
+	if (!n->arena_string)
+		free(n->u.string);
+}
+
+static void config_free_node(snd_config_t *n)
+{
+	if (n->arena)
+		config_arena_unref(n->arena);
+	else
+		free(n);
+}
+
+static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type,
+			    struct config_arena *arena)
 {
 	snd_config_t *n;
 	assert(config);
-	n = calloc(1, sizeof(*n));
+	if (arena) {
+		n = config_arena_alloc(arena, sizeof(*n), CONFIG_ARENA_ALIGN);
+		if (n) {
+			memset(n, 0, sizeof(*n));
+			n->arena = arena;
+			arena->refs++;
+		}
+	} else
+		n = calloc(1, sizeof(*n));
 	if (n == NULL) {
-		if (*id) {
+		if (id && *id) {
 			free(*id);
 			*id = NULL;
 		}
@@ -930,17 +1230,166 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 }
 	
 
+static unsigned int config_hash(const char *id, size_t len)
+{
+	unsigned int hash = 2166136261U;
+
+	while (len-- > 0)
+		hash = (hash ^ (unsigned char)*id++) * 16777619U;
+	return hash;
+}
+
+static void config_index_insert(struct config_index *index, snd_config_t *n)
+{
+	snd_config_t **b = &index->buckets[n->hash & index->mask];
+
+	n->hash_next = *b;
+	*b = n;
+}
+
+static void config_index_unlink(struct config_index *index, snd_config_t *n)
+{
+	snd_config_t **b = &index->buckets[n->hash & index->mask];
+
+	for (; *b; b = &(*b)->hash_next) {
+		if (*b == n) {
+			*b = n->hash_next;
+			break;
+		}
+	}
+	n->hash_next = NULL;
+}
+
+static int config_index_search(struct config_index *index, const char *id,
+			       int len, snd_config_t **result)
+{
+	size_t l = len < 0 ? strlen(id) : (size_t)len;
+	unsigned int hash = config_hash(id, l);
+	snd_config_t *n;
+
+	for (n = index->buckets[hash & index->mask]; n; n = n->hash_next) {
+		if (n->hash != hash || strncmp(n->id, id, l) != 0 || n->id[l])
+			continue;
+		if (result)
+			*result = n;
+		return 0;
+	}
+	return -ENOENT;
+}
+
+/* (re)build the index of a compound, sized for its current children */
+static void config_index_build(snd_config_t *config)
+{
+	struct config_index *index;
+	snd_config_iterator_t i, next;
+	unsigned int size = CONFIG_INDEX_MIN * 2;
+
+	while (size < config->u.compound.count)
+		size *= 2;
+	index = calloc(1, sizeof(*index) + size * sizeof(index->buckets[0]));
+	if (!index)
+		return;		/* keep on searching the list */
+	index->mask = size - 1;
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		n->hash = config_hash(n->id, strlen(n->id));
+		config_index_insert(index, n);
+	}
+	free(config->u.compound.index);
+	config->u.compound.index = index;
+}
+
+static void config_child_add(snd_config_t *parent, snd_config_t *n)
+{
+	struct config_index *index = parent->u.compound.index;
+
+	n->parent = parent;
+	list_add_tail(&n->list, &parent->u.compound.fields);
+	parent->u.compound.count++;
+	if (index && parent->u.compound.count <= (index->mask + 1) * 2) {
+		n->hash = config_hash(n->id, strlen(n->id));
+		config_index_insert(index, n);
+	} else if (parent->u.compound.count >= CONFIG_INDEX_MIN)
+		config_index_build(parent);
+}
+
+static void config_child_del(snd_config_t *n)
+{
+	snd_config_t *parent = n->parent;
+
+	list_del(&n->list);
+	if (parent->u.compound.count > 0)
+		parent->u.compound.count--;
+	if (parent->u.compound.index)
+		config_index_unlink(parent->u.compound.index, n);
+}
+
+/*
+ *  Memoized expansion of definitions from the global tree, see
+ *  config_memo_expand(); protected by snd_config_lock(), except the
+ *  recorder of the running expansion, which is private to the thread
+ *  holding the lock, so the evaluate functions called without the lock
+ *  in other threads don't record into it
+ */
+
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
+
+#define CONFIG_MEMO_MAX		32
+
+struct config_memo_env {
+	struct config_memo_env *next;
+	char *value;			/* NULL if the variable was not set */
+	char name[0];
+};
+
+struct config_memo_rec {
+	int uncacheable;		/* a non-memoizable function was called */
+	struct config_memo_env *env;	/* environment variables read */
+};
+
+struct config_memo {
+	struct list_head list;
+	const snd_config_t *def;	/* compared by address only */
+	char *args;
+	struct config_memo_env *env;
+	snd_config_t *result;
+};
+
+static LIST_HEAD(config_memo_list);
+static unsigned int config_memo_count;
+static unsigned int config_memo_generation;
+static TLS_PFX struct config_memo_rec *config_memo_rec;
+static unsigned int config_generation;
+
+static void config_memo_flush(void);
+
+/* note a modification of a tree, invalidates the memoized expansions
+ * if the tree is the global one
+ */
+static void config_touch(const snd_config_t *config)
+{
+	if (!config_memo_count && !config_memo_rec)
+		return;
+	while (config->parent)
+		config = config->parent;
+	if (config == snd_config)
+		config_generation++;
+}
+
 static int _snd_config_make_add(snd_config_t **config, char **id,
 				snd_config_type_t type, snd_config_t *parent)
 {
 	snd_config_t *n;
 	int err;
 	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
-	err = _snd_config_make(&n, id, type);
+	err = _snd_config_make(&n, id, type, parent->arena);
 	if (err < 0)
 		return err;
-	n->parent = parent;
-	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_child_add(parent, n);
 	*config = n;
 	return 0;
 }
@@ -949,6 +1398,8 @@ static int _snd_config_search(snd_config_t *config,
 			      const char *id, int len, snd_config_t **result)
 {
 	snd_config_iterator_t i, next;
+	if (config->u.compound.index)
+		return config_index_search(config->u.compound.index, id, len, result);
 	snd_config_for_each(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (len < 0) {
@@ -1034,8 +1485,9 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 		if (err < 0)
 			return err;
 	}
-	free(n->u.string);
+	config_free_string(n);
 	n->u.string = s;
+	n->arena_string = 0;
 	*_n = n;
 	return 0;
 }
@@ -1101,7 +1553,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 		break;
 	}
 	default:
-		unget_char(c, input);
+		unget_nonwhite(c, input);
 		err = parse_value(&n, parent, input, &id, skip);
 		if (err < 0)
 			goto __end;
@@ -1120,7 +1572,7 @@ static int parse_array_defs(snd_config_t *parent, input_t *input, int skip, int
 		int c = get_nonwhite(input), err;
 		if (c < 0)
 			return c;
-		unget_char(c, input);
+		unget_nonwhite(c, input);
 		if (c == ']')
 			return 0;
 		err = parse_array_def(parent, input, idx++, skip, override);
@@ -1147,16 +1599,19 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 			break;
 		case '-':
 			mode = MERGE;
+			input->modes = 1;
 			break;
 		case '?':
 			mode = DONT_OVERRIDE;
+			input->modes = 1;
 			break;
 		case '!':
 			mode = OVERRIDE;
+			input->modes = 1;
 			break;
 		default:
 			mode = !override ? MERGE_CREATE : OVERRIDE;
-			unget_char(c, input);
+			unget_nonwhite(c, input);
 		}
 		err = get_string(&id, 1, input);
 		if (err < 0)
@@ -1255,7 +1710,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 		break;
 	}
 	default:
-		unget_char(c, input);
+		unget_nonwhite(c, input);
 		err = parse_value(&n, parent, input, &id, skip);
 		if (err < 0)
 			goto __end;
@@ -1267,7 +1722,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 	case ',':
 		break;
 	default:
-		unget_char(c, input);
+		unget_nonwhite(c, input);
 	}
       __end:
 	free(id);
@@ -1281,7 +1736,7 @@ static int parse_defs(snd_config_t *parent, input_t *input, int skip, int overri
 		c = get_nonwhite(input);
 		if (c < 0)
 			return c == LOCAL_UNEXPECTED_EOF ? 0 : c;
-		unget_char(c, input);
+		unget_nonwhite(c, input);
 		if (c == '}')
 			return 0;
 		err = parse_def(parent, input, skip, override);
@@ -1484,7 +1939,30 @@ static int _snd_config_save_children(snd_config_t *config, snd_output_t *out,
  */
 int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 {
+	char *id = src->id, *str = NULL;
+	int arena_id = src->arena_id, arena_string = 0;
+
 	assert(dst && src);
+	config_touch(dst);
+	/* values owned by the arena of src must not outlive it */
+	if (src->arena != dst->arena) {
+		if (arena_id && id) {
+			id = config_strdup(dst, id);
+			if (!id)
+				return -ENOMEM;
+			arena_id = dst->arena != NULL;
+		}
+		if (src->type == SND_CONFIG_TYPE_STRING && src->arena_string &&
+		    src->u.string) {
+			str = config_strdup(dst, src->u.string);
+			if (!str) {
+				if (id != src->id && !arena_id)
+					free(id);
+				return -ENOMEM;
+			}
+			arena_string = dst->arena != NULL;
+		}
+	}
 	if (dst->type == SND_CONFIG_TYPE_COMPOUND &&
 	    src->type == SND_CONFIG_TYPE_COMPOUND) {	/* append */
 		snd_config_iterator_t i, next;
@@ -1494,17 +1972,25 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		}
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
+		free(dst->u.compound.index);
 	} else if (dst->type == SND_CONFIG_TYPE_COMPOUND) {
 		int err;
 		err = snd_config_delete_compound_members(dst);
 		if (err < 0)
 			return err;
+		free(dst->u.compound.index);
 	}
-	free(dst->id);
-	dst->id = src->id;
+	config_free_id(dst);
+	dst->id = id;
+	dst->arena_id = arena_id;
 	dst->type = src->type;
 	dst->u = src->u;
-	free(src);
+	if (str) {
+		dst->u.string = str;
+		dst->arena_string = arena_string;
+	} else
+		dst->arena_string = src->arena_string && src->arena == dst->arena;
+	config_free_node(src);
 	return 0;
 }
 
@@ -1607,18 +2093,18 @@ int snd_config_get_id(const snd_config_t *config, const char **id)
  */
 int snd_config_set_id(snd_config_t *config, const char *id)
 {
-	snd_config_iterator_t i, next;
+	struct config_index *index = NULL;
+	snd_config_t *n;
 	char *new_id;
 	assert(config);
 	if (id) {
 		if (config->parent) {
-			snd_config_for_each(i, next, config->parent) {
-				snd_config_t *n = snd_config_iterator_entry(i);
-				if (n != config && strcmp(id, n->id) == 0)
-					return -EEXIST;
-			}
+			if (_snd_config_search(config->parent, id, -1, &n) == 0 &&
+			    n != config)
+				return -EEXIST;
+			index = config->parent->u.compound.index;
 		}
-		new_id = strdup(id);
+		new_id = config_strdup(config, id);
 		if (!new_id)
 			return -ENOMEM;
 	} else {
@@ -1626,8 +2112,16 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 			return -EINVAL;
 		new_id = NULL;
 	}
-	free(config->id);
+	config_touch(config);
+	if (index)
+		config_index_unlink(index, config);
+	config_free_id(config);
 	config->id = new_id;
+	config->arena_id = config->arena != NULL;
+	if (index) {
+		config->hash = config_hash(new_id, strlen(new_id));
+		config_index_insert(index, config);
+	}
 	return 0;
 }
 
@@ -1650,15 +2144,28 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 int snd_config_top(snd_config_t **config)
 {
 	assert(config);
-	return _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND);
+	return _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND, NULL);
 }
 
-static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
+/* create a top level node allocating the tree from a new arena */
+static int config_top_arena(snd_config_t **config)
+{
+	struct config_arena *arena = config_arena_new();
+	int err;
+
+	if (!arena)
+		return -ENOMEM;
+	err = _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND, arena);
+	config_arena_unref(arena);
+	return err;
+}
+
+static int snd_config_load_input(snd_config_t *config, snd_input_t *in,
+				 input_t *input, int override)
 {
 	int err;
-	input_t input;
 	struct filedesc *fd, *fd_next;
-	assert(config && in);
+	config_touch(config);
 	fd = malloc(sizeof(*fd));
 	if (!fd)
 		return -ENOMEM;
@@ -1667,10 +2174,10 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
 	fd->line = 1;
 	fd->column = 0;
 	fd->next = NULL;
-	input.current = fd;
-	input.unget = 0;
-	err = parse_defs(config, &input, 0, override);
-	fd = input.current;
+	input->current = fd;
+	input->unget = 0;
+	err = parse_defs(config, input, 0, override);
+	fd = input->current;
 	if (err < 0) {
 		const char *str;
 		switch (err) {
@@ -1697,7 +2204,7 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
 		SNDERR("%s:%d:%d:%s", fd->name ? fd->name : "_toplevel_", fd->line, fd->column, str);
 		goto _end;
 	}
-	if (get_char(&input) != LOCAL_UNEXPECTED_EOF) {
+	if (get_char(input) != LOCAL_UNEXPECTED_EOF) {
 		SNDERR("%s:%d:%d:Unexpected }", fd->name ? fd->name : "", fd->line, fd->column);
 		err = -EINVAL;
 		goto _end;
@@ -1714,6 +2221,501 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
 	return err;
 }
 
+static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
+{
+	input_t input;
+	assert(config && in);
+	memset(&input, 0, sizeof(input));
+	return snd_config_load_input(config, in, &input, override);
+}
+
+/* check that src can be merged into dst like the parser would do it */
+static int config_merge_check(const snd_config_t *dst, const snd_config_t *src)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *n;
+	int err;
+
+	snd_config_for_each(i, next, src) {
+		snd_config_t *c = snd_config_iterator_entry(i);
+		if (_snd_config_search((snd_config_t *)dst, c->id, -1, &n) < 0)
+			continue;
+		switch (n->type) {
+		case SND_CONFIG_TYPE_INTEGER:
+		case SND_CONFIG_TYPE_INTEGER64:
+			if (c->type != SND_CONFIG_TYPE_INTEGER &&
+			    c->type != SND_CONFIG_TYPE_INTEGER64)
+				return -EINVAL;
+			break;
+		case SND_CONFIG_TYPE_COMPOUND:
+			if (c->type != SND_CONFIG_TYPE_COMPOUND)
+				return -EINVAL;
+			err = config_merge_check(n, c);
+			if (err < 0)
+				return err;
+			break;
+		default:
+			if (c->type != n->type)
+				return -EINVAL;
+			break;
+		}
+	}
+	return 0;
+}
+
+/* move the nodes of src into dst, existing values are overwritten */
+static void config_merge(snd_config_t *dst, snd_config_t *src)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *n;
+
+	snd_config_for_each(i, next, src) {
+		snd_config_t *c = snd_config_iterator_entry(i);
+		if (_snd_config_search(dst, c->id, -1, &n) < 0) {
+			config_child_del(c);
+			config_child_add(dst, c);
+			continue;
+		}
+		switch (n->type) {
+		case SND_CONFIG_TYPE_COMPOUND:
+			n->u.compound.join |= c->u.compound.join;
+			config_merge(n, c);
+			break;
+		case SND_CONFIG_TYPE_INTEGER:
+			n->u.integer = c->type == SND_CONFIG_TYPE_INTEGER ?
+				c->u.integer : (long)c->u.integer64;
+			break;
+		case SND_CONFIG_TYPE_INTEGER64:
+			n->u.integer64 = c->type == SND_CONFIG_TYPE_INTEGER ?
+				c->u.integer : c->u.integer64;
+			break;
+		case SND_CONFIG_TYPE_REAL:
+			n->u.real = c->u.real;
+			break;
+		case SND_CONFIG_TYPE_STRING:
+			config_free_string(n);
+			if (c->arena_string && c->u.string) {
+				n->u.string = config_strdup(n, c->u.string);
+				n->arena_string = n->arena != NULL;
+			} else {
+				n->u.string = c->u.string;
+				n->arena_string = 0;
+				c->u.string = NULL;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/** The name of the environment variable containing the directory of the configuration cache. */
+#define ALSA_CONFIG_CACHE_VAR "ALSA_CONFIG_CACHE"
+
+static unsigned long long config_cache_hash(unsigned long long hash,
+					    const char *str)
+{
+	const unsigned char *p = (const unsigned char *)str;
+
+	do
+		hash = (hash ^ *p) * 1099511628211ULL;
+	while (*p++);
+	return hash;
+}
+
+/*
+ * The relative file names and the <confdir:> includes resolve against
+ * the working and the configuration directory, so both are a part of
+ * the key; the identity of the resolved files is checked on the load.
+ */
+static void config_cache_path(char *path, size_t size, const char *dir,
+			      const char *filename)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	char cwd[PATH_MAX];
+
+	if (!getcwd(cwd, sizeof(cwd)))
+		cwd[0] = '\0';
+	hash = config_cache_hash(hash, filename);
+	hash = config_cache_hash(hash, cwd);
+	hash = config_cache_hash(hash, ALSA_CONFIG_DIR);
+	snprintf(path, size, "%s/%016llx.bin", dir, hash);
+}
+
+/*
+ * The cache is replayed as configuration (including hooks and functions
+ * loaded from shared objects), so only files and directories which only
+ * the user can write are trusted.
+ */
+static int config_cache_trusted(const struct stat *st)
+{
+	return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/*
+ * Return 1 when there is no valid cache entry for the file.  The entry
+ * is replayed into a new tree which is merged into root only when it's
+ * complete, so an entry which fails to replay (it's removed) leaves root
+ * untouched for the text parse and 1 is returned, too.
+ */
+static int config_cache_load(snd_config_t *root, const char *dir,
+			     const char *filename)
+{
+	char path[PATH_MAX], name[PATH_MAX];
+	const struct cache_header *hdr;
+	const unsigned char *map, *p, *end;
+	struct stat st;
+	size_t size;
+	unsigned int k;
+	int fd, err = 1;
+
+	config_cache_path(path, sizeof(path), dir, filename);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    !config_cache_trusted(&st) || (size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return 1;
+	}
+	size = st.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 1;
+	end = map + size;
+	hdr = (const struct cache_header *)map;
+	if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != CACHE_VERSION || hdr->ndeps == 0)
+		goto _end;
+	p = map + sizeof(*hdr);
+	for (k = 0; k < hdr->ndeps; k++) {
+		const struct cache_dep *dep = (const struct cache_dep *)p;
+		struct cache_dep cur;
+
+		if ((size_t)(end - p) < sizeof(*dep) || dep->len >= PATH_MAX ||
+		    (size_t)(end - p) < CACHE_DEP_SIZE(dep->len))
+			goto _end;
+		memcpy(name, p + sizeof(*dep), dep->len);
+		name[dep->len] = '\0';
+		if (k == 0 && strcmp(name, filename) != 0)
+			goto _end;
+		if (stat(name, &st) < 0)
+			goto _end;
+		cache_dep_fill(&cur, &st, dep->len);
+		if (memcmp(&cur, dep, sizeof(cur)) != 0)
+			goto _end;
+		p += CACHE_DEP_SIZE(dep->len);
+	}
+	if ((uint64_t)(end - p) != hdr->size)
+		goto _end;
+	{
+		snd_config_t *tree;
+		input_t input;
+
+		err = config_top_arena(&tree);
+		if (err < 0)
+			goto _end;
+		memset(&input, 0, sizeof(input));
+		input.replay = p;
+		input.replay_end = end;
+		err = snd_config_load_input(tree, NULL, &input, 0);
+		if (err < 0) {
+			unlink(path);
+			err = 1;
+		} else if (!input.modes && config_merge_check(root, tree) >= 0) {
+			config_touch(root);
+			config_merge(root, tree);
+		} else {
+			/* explicit modes and conflicts act on the nodes
+			 * of root, replay once more straight into it */
+			memset(&input, 0, sizeof(input));
+			input.replay = p;
+			input.replay_end = end;
+			err = snd_config_load_input(root, NULL, &input, 0);
+		}
+		snd_config_delete(tree);
+	}
+ _end:
+	munmap((void *)map, size);
+	return err;
+}
+
+static int config_cache_write(int fd, const void *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t res = write(fd, buf, len);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *)buf + res;
+		len -= res;
+	}
+	return 0;
+}
+
+static void config_cache_save(struct cache_rec *rec, const char *dir,
+			      const char *filename)
+{
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	struct cache_header hdr;
+	int fd, err;
+
+	config_cache_path(path, sizeof(path), dir, filename);
+	snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = CACHE_VERSION;
+	hdr.ndeps = rec->ndeps;
+	hdr.size = rec->len;
+	err = config_cache_write(fd, &hdr, sizeof(hdr));
+	if (err >= 0)
+		err = config_cache_write(fd, rec->deps, rec->deps_len);
+	if (err >= 0)
+		err = config_cache_write(fd, rec->buf, rec->len);
+	if (close(fd) < 0 && err >= 0)
+		err = -errno;
+	if (err < 0 || rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+/*
+ * Load a configuration file.  When ALSA_CONFIG_CACHE names a directory,
+ * the token stream of the parsed file is kept there together with the
+ * identity (device, inode, times and size) of the file and of all files
+ * it includes.  Later loads replay the tokens from the mmap'd cache
+ * instead of lexing the text again; the replay runs through the same
+ * parser, so merging into an existing tree behaves exactly the same.
+ */
+static int config_file_load(snd_config_t *root, snd_input_t *in,
+			    const char *filename)
+{
+	const char *dir = getenv(ALSA_CONFIG_CACHE_VAR);
+	struct cache_rec rec;
+	struct stat st;
+	input_t input;
+	int err;
+
+	if (!dir || !*dir || stat(dir, &st) < 0 || !S_ISDIR(st.st_mode) ||
+	    !config_cache_trusted(&st))
+		return snd_config_load(root, in);
+	err = config_cache_load(root, dir, filename);
+	if (err <= 0)
+		return err;
+	memset(&rec, 0, sizeof(rec));
+	cache_rec_dep(&rec, filename);
+	memset(&input, 0, sizeof(input));
+	input.rec = &rec;
+	err = snd_config_load_input(root, in, &input, 0);
+	if (err >= 0 && !rec.failed)
+		config_cache_save(&rec, dir, filename);
+	free(rec.buf);
+	free(rec.deps);
+	return err;
+}
+
+/** The name of the environment variable containing the number of threads parsing configuration files. */
+#define ALSA_CONFIG_THREADS_VAR "ALSA_CONFIG_THREADS"
+
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE___THREAD)
+#define CONFIG_PREFETCH
+#define CONFIG_THREADS_MAX	16
+#endif
+
+#ifdef CONFIG_PREFETCH
+/*
+ * Parallel parsing of a list of configuration files.  The worker threads
+ * parse each file into a private tree, which is then merged into the
+ * real tree in the order of the list.  Merging a tree parsed in the
+ * default merge+create mode is equivalent to parsing the file straight
+ * into the real tree, so only such files are merged; a file using an
+ * explicit mode, failing to parse on its own or conflicting with the
+ * existing nodes is simply loaded again in sequence, which also reports
+ * the errors as usual.
+ */
+struct config_prefetch_file {
+	const char *name;
+	snd_config_t *tree;
+	int err;
+	int done;
+};
+
+struct config_prefetch {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct config_prefetch_file *files;
+	unsigned int count;
+	unsigned int next;		/* next file to be claimed by a worker */
+	unsigned int nthreads;
+	pthread_t threads[CONFIG_THREADS_MAX];
+};
+
+static void config_prefetch_error(const char *file ATTRIBUTE_UNUSED,
+				  int line ATTRIBUTE_UNUSED,
+				  const char *function ATTRIBUTE_UNUSED,
+				  int err ATTRIBUTE_UNUSED,
+				  const char *fmt ATTRIBUTE_UNUSED,
+				  va_list arg ATTRIBUTE_UNUSED)
+{
+	/* reported again by the sequential load */
+}
+
+static void config_prefetch_file(struct config_prefetch_file *f)
+{
+	snd_input_t *in;
+	input_t input;
+
+	f->err = snd_input_stdio_open(&in, f->name, "r");
+	if (f->err < 0)
+		return;
+	f->err = config_top_arena(&f->tree);
+	if (f->err >= 0) {
+		memset(&input, 0, sizeof(input));
+		f->err = snd_config_load_input(f->tree, in, &input, 0);
+		if (f->err >= 0 && input.modes)
+			f->err = -EINVAL;
+		if (f->err < 0) {
+			snd_config_delete(f->tree);
+			f->tree = NULL;
+		}
+	}
+	snd_input_close(in);
+}
+
+static void *config_prefetch_thread(void *arg)
+{
+	struct config_prefetch *pf = arg;
+	struct config_prefetch_file *f;
+
+	snd_lib_error_set_local(config_prefetch_error);
+	pthread_mutex_lock(&pf->mutex);
+	while (pf->next < pf->count) {
+		f = &pf->files[pf->next++];
+		pthread_mutex_unlock(&pf->mutex);
+		config_prefetch_file(f);
+		pthread_mutex_lock(&pf->mutex);
+		f->done = 1;
+		pthread_cond_broadcast(&pf->cond);
+	}
+	pthread_mutex_unlock(&pf->mutex);
+	return NULL;
+}
+
+static void config_prefetch_free(struct config_prefetch *pf)
+{
+	unsigned int k;
+
+	if (!pf)
+		return;
+	pthread_mutex_lock(&pf->mutex);
+	pf->next = pf->count;
+	pthread_mutex_unlock(&pf->mutex);
+	for (k = 0; k < pf->nthreads; k++)
+		pthread_join(pf->threads[k], NULL);
+	for (k = 0; k < pf->count; k++)
+		if (pf->files[k].tree)
+			snd_config_delete(pf->files[k].tree);
+	pthread_cond_destroy(&pf->cond);
+	pthread_mutex_destroy(&pf->mutex);
+	free(pf->files);
+	free(pf);
+}
+
+/* start parsing the files in the background when ALSA_CONFIG_THREADS
+ * asks for it; the binary cache has precedence
+ */
+static struct config_prefetch *config_prefetch_start(const char *const *names,
+						     unsigned int count)
+{
+	struct config_prefetch *pf;
+	const char *env;
+	long threads;
+	unsigned int k;
+
+	env = getenv(ALSA_CONFIG_THREADS_VAR);
+	if (!env || safe_strtol(env, &threads) < 0 || threads < 2 || count < 2)
+		return NULL;
+	env = getenv(ALSA_CONFIG_CACHE_VAR);
+	if (env && *env)
+		return NULL;
+	if (threads > CONFIG_THREADS_MAX)
+		threads = CONFIG_THREADS_MAX;
+	if ((unsigned long)threads > count)
+		threads = count;
+	pf = calloc(1, sizeof(*pf));
+	if (!pf)
+		return NULL;
+	pf->files = calloc(count, sizeof(*pf->files));
+	if (!pf->files) {
+		free(pf);
+		return NULL;
+	}
+	for (k = 0; k < count; k++)
+		pf->files[k].name = names[k];
+	pf->count = count;
+	pthread_mutex_init(&pf->mutex, NULL);
+	pthread_cond_init(&pf->cond, NULL);
+	for (k = 0; k < (unsigned int)threads; k++) {
+		if (pthread_create(&pf->threads[k], NULL,
+				   config_prefetch_thread, pf))
+			break;
+		pf->nthreads++;
+	}
+	if (!pf->nthreads) {
+		config_prefetch_free(pf);
+		return NULL;
+	}
+	return pf;
+}
+
+/* load the k-th file of the list from its prefetched tree; returns 1
+ * when the file must be loaded in the usual way
+ */
+static int config_prefetch_load(struct config_prefetch *pf, unsigned int k,
+				snd_config_t *root)
+{
+	struct config_prefetch_file *f;
+
+	if (!pf)
+		return 1;
+	f = &pf->files[k];
+	pthread_mutex_lock(&pf->mutex);
+	while (!f->done)
+		pthread_cond_wait(&pf->cond, &pf->mutex);
+	pthread_mutex_unlock(&pf->mutex);
+	if (f->err < 0 || config_merge_check(root, f->tree) < 0)
+		return 1;
+	config_touch(root);
+	config_merge(root, f->tree);
+	return 0;
+}
+#else
+struct config_prefetch;
+
+static inline struct config_prefetch *
+config_prefetch_start(const char *const *names ATTRIBUTE_UNUSED,
+		      unsigned int count ATTRIBUTE_UNUSED)
+{
+	return NULL;
+}
+
+static inline void config_prefetch_free(struct config_prefetch *pf ATTRIBUTE_UNUSED)
+{
+}
+
+static inline int config_prefetch_load(struct config_prefetch *pf ATTRIBUTE_UNUSED,
+				       unsigned int k ATTRIBUTE_UNUSED,
+				       snd_config_t *root ATTRIBUTE_UNUSED)
+{
+	return 1;
+}
+#endif /* CONFIG_PREFETCH */
+
 /**
  * \brief Loads a configuration tree.
  * \param config Handle to a top level configuration node.
@@ -1776,17 +2778,13 @@ int snd_config_load_override(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	assert(parent && child);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
-	child->parent = parent;
-	list_add_tail(&child->list, &parent->u.compound.fields);
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	config_touch(parent);
+	config_child_add(parent, child);
 	return 0;
 }
 
@@ -1806,8 +2804,10 @@ int snd_config_add(snd_config_t *parent, snd_config_t *child)
 int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
-	if (config->parent)
-		list_del(&config->list);
+	if (config->parent) {
+		config_touch(config);
+		config_child_del(config);
+	}
 	config->parent = NULL;
 	return 0;
 }
@@ -1833,6 +2833,7 @@ int snd_config_remove(snd_config_t *config)
 int snd_config_delete(snd_config_t *config)
 {
 	assert(config);
+	config_touch(config);
 	switch (config->type) {
 	case SND_CONFIG_TYPE_COMPOUND:
 	{
@@ -1847,18 +2848,19 @@ int snd_config_delete(snd_config_t *config)
 				return err;
 			i = nexti;
 		}
+		free(config->u.compound.index);
 		break;
 	}
 	case SND_CONFIG_TYPE_STRING:
-		free(config->u.string);
+		config_free_string(config);
 		break;
 	default:
 		break;
 	}
 	if (config->parent)
-		list_del(&config->list);
-	free(config->id);
-	free(config);
+		config_child_del(config);
+	config_free_id(config);
+	config_free_node(config);
 	return 0;
 }
 
@@ -1930,7 +2932,29 @@ int snd_config_make(snd_config_t **config, const char *id,
 			return -ENOMEM;
 	} else
 		id1 = NULL;
-	return _snd_config_make(config, &id1, type);
+	return _snd_config_make(config, &id1, type, NULL);
+}
+
+/* create a node like snd_config_make(), allocated from the given arena */
+static int config_make_node(snd_config_t **config, const char *id,
+			    snd_config_type_t type, struct config_arena *arena)
+{
+	char *id1 = NULL;
+	int err;
+
+	if (!arena)
+		return snd_config_make(config, id, type);
+	if (id) {
+		id1 = config_arena_strdup(arena, id);
+		if (!id1)
+			return -ENOMEM;
+	}
+	err = _snd_config_make(config, NULL, type, arena);
+	if (err < 0)
+		return err;
+	(*config)->id = id1;
+	(*config)->arena_id = 1;
+	return 0;
 }
 
 /**
@@ -2306,6 +3330,7 @@ int snd_config_set_integer(snd_config_t *config, long value)
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_INTEGER)
 		return -EINVAL;
+	config_touch(config);
 	config->u.integer = value;
 	return 0;
 }
@@ -2329,6 +3354,7 @@ int snd_config_set_integer64(snd_config_t *config, long long value)
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_INTEGER64)
 		return -EINVAL;
+	config_touch(config);
 	config->u.integer64 = value;
 	return 0;
 }
@@ -2349,6 +3375,7 @@ int snd_config_set_real(snd_config_t *config, double value)
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_REAL)
 		return -EINVAL;
+	config_touch(config);
 	config->u.real = value;
 	return 0;
 }
@@ -2377,14 +3404,16 @@ int snd_config_set_string(snd_config_t *config, const char *value)
 	if (config->type != SND_CONFIG_TYPE_STRING)
 		return -EINVAL;
 	if (value) {
-		new_string = strdup(value);
+		new_string = config_strdup(config, value);
 		if (!new_string)
 			return -ENOMEM;
 	} else {
 		new_string = NULL;
 	}
-	free(config->u.string);
+	config_touch(config);
+	config_free_string(config);
 	config->u.string = new_string;
+	config->arena_string = config->arena != NULL;
 	return 0;
 }
 
@@ -2406,6 +3435,7 @@ int snd_config_set_pointer(snd_config_t *config, const void *value)
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_POINTER)
 		return -EINVAL;
+	config_touch(config);
 	config->u.ptr = value;
 	return 0;
 }
@@ -2438,6 +3468,7 @@ int snd_config_set_pointer(snd_config_t *config, const void *value)
 int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 {
 	assert(config && ascii);
+	config_touch(config);
 	switch (config->type) {
 	case SND_CONFIG_TYPE_INTEGER:
 		{
@@ -2468,11 +3499,12 @@ int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 		}
 	case SND_CONFIG_TYPE_STRING:
 		{
-			char *ptr = strdup(ascii);
+			char *ptr = config_strdup(config, ascii);
 			if (ptr == NULL)
 				return -ENOMEM;
-			free(config->u.string);
+			config_free_string(config);
 			config->u.string = ptr;
+			config->arena_string = config->arena != NULL;
 		}
 		break;
 	default:
@@ -3288,7 +4320,6 @@ static snd_config_update_t *snd_config_global_update = NULL;
 
 static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_config_t *private_data)
 {
-	void *h = NULL;
 	snd_config_t *c, *func_conf = NULL;
 	char *buf = NULL;
 	const char *lib = NULL, *func_name = NULL;
@@ -3350,17 +4381,9 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 		buf[len-1] = '\0';
 		func_name = buf;
 	}
-	h = snd_dlopen(lib, RTLD_NOW);
-	func = h ? snd_dlsym(h, func_name, SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_HOOK)) : NULL;
-	err = 0;
-	if (!h) {
-		SNDERR("Cannot open shared library %s", lib);
-		err = -ENOENT;
-	} else if (!func) {
-		SNDERR("symbol %s is not defined inside %s", func_name, lib);
-		snd_dlclose(h);
-		err = -ENXIO;
-	}
+	func = snd_dlobj_cache_get(lib, func_name,
+			SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_HOOK), 1);
+	err = func ? 0 : -errno;
 	_err:
 	if (func_conf)
 		snd_config_delete(func_conf);
@@ -3369,7 +4392,7 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 		err = func(root, config, &nroot, private_data);
 		if (err < 0)
 			SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
-		snd_dlclose(h);
+		snd_dlobj_cache_put(func);
 		if (err >= 0 && nroot)
 			err = snd_config_substitute(root, nroot);
 	}
@@ -3443,7 +4466,7 @@ static int config_file_open(snd_config_t *root, const char *filename)
 
 	err = snd_input_stdio_open(&in, filename, "r");
 	if (err >= 0) {
-		err = snd_config_load(root, in);
+		err = config_file_load(root, in, filename);
 		snd_input_close(in);
 		if (err < 0)
 			SNDERR("%s may be old or corrupted: consider to remove or fix it", filename);
@@ -3453,6 +4476,26 @@ static int config_file_open(snd_config_t *root, const char *filename)
 	return err;
 }
 
+static int config_files_add(char ***files, unsigned int *count,
+			    unsigned int *alloc, char *name)
+{
+	char **ptr;
+
+	if (!name)
+		return -ENOMEM;
+	if (*count == *alloc) {
+		ptr = realloc(*files, (*alloc + 16) * sizeof(*ptr));
+		if (!ptr) {
+			free(name);
+			return -ENOMEM;
+		}
+		*files = ptr;
+		*alloc += 16;
+	}
+	(*files)[(*count)++] = name;
+	return 0;
+}
+
 /**
  * \brief Loads and parses the given configurations files.
  * \param[in] root Handle to the root configuration node.
@@ -3470,6 +4513,9 @@ int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t
 	snd_config_t *n;
 	snd_config_iterator_t i, next;
 	struct finfo *fi = NULL;
+	struct config_prefetch *pf;
+	char **files = NULL;
+	unsigned int k, files_count = 0, files_alloc = 0;
 	int err, idx = 0, fi_count = 0, errors = 1, hit;
 
 	assert(root && dst);
@@ -3563,11 +4609,11 @@ int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t
 					if (err >= 0) {
 						int sl = strlen(fi[idx].name) + strlen(namelist[j]->d_name) + 2;
 						char *filename = malloc(sl);
-						snprintf(filename, sl, "%s/%s", fi[idx].name, namelist[j]->d_name);
-						filename[sl-1] = '\0';
-
-						err = config_file_open(root, filename);
-						free(filename);
+						if (filename) {
+							snprintf(filename, sl, "%s/%s", fi[idx].name, namelist[j]->d_name);
+							filename[sl-1] = '\0';
+						}
+						err = config_files_add(&files, &files_count, &files_alloc, filename);
 					}
 					free(namelist[j]);
 				}
@@ -3575,12 +4621,33 @@ int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t
 				if (err < 0)
 					goto _err;
 			}
-		} else if ((err = config_file_open(root, fi[idx].name)) < 0)
-			goto _err;
+		} else {
+			char *filename = strdup(fi[idx].name);
+			err = config_files_add(&files, &files_count, &files_alloc, filename);
+			if (err < 0)
+				goto _err;
+		}
+	}
+	/* the files are collected first, so they can be parsed in parallel */
+	pf = config_prefetch_start((const char *const *)files, files_count);
+	for (k = 0; k < files_count; k++) {
+		err = config_prefetch_load(pf, k, root);
+		if (err > 0)
+			err = config_file_open(root, files[k]);
+		else if (err < 0)
+			SNDERR("%s may be old or corrupted: consider to remove or fix it", files[k]);
+		if (err < 0)
+			break;
 	}
+	config_prefetch_free(pf);
+	if (err < 0)
+		goto _err;
 	*dst = NULL;
 	err = 0;
        _err:
+	for (k = 0; k < files_count; k++)
+		free(files[k]);
+	free(files);
 	if (fi)
 		for (idx = 0; idx < fi_count; idx++)
 			free(fi[idx].name);
@@ -3679,6 +4746,18 @@ SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VER
  * The global configuration files are specified in the environment variable
  * \c ALSA_CONFIG_PATH.
  *
+ * If the environment variable \c ALSA_CONFIG_CACHE names a directory
+ * owned by the effective user and not writable by group or others, a
+ * binary form of each parsed file (including the files
+ * loaded by the load hooks) is stored there and reused by later
+ * processes as long as the file and all files it includes are unchanged.
+ *
+ * Otherwise, if the environment variable \c ALSA_CONFIG_THREADS is set
+ * to a number greater than one, the configuration files (and the files
+ * loaded by the load hooks) are parsed by that many threads in parallel.
+ * The resulting tree is the same as when they are parsed one after
+ * another.
+ *
  * \warning If the configuration tree is reread, all string pointers and
  * configuration node handles previously obtained from this tree become
  * invalid.
@@ -3696,6 +4775,7 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	snd_config_update_t *local;
 	snd_config_update_t *update;
 	snd_config_t *top;
+	struct config_prefetch *pf;
 	
 	assert(_top && _update);
 	top = *_top;
@@ -3785,6 +4865,9 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	return err;
 
  _reread:
+	/* the memoized expansions point to the nodes of the old tree */
+	if (top && top == snd_config)
+		config_generation++;
  	*_top = NULL;
  	*_update = NULL;
  	if (update) {
@@ -3795,25 +4878,37 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		snd_config_delete(top);
 		top = NULL;
 	}
-	err = snd_config_top(&top);
+	err = config_top_arena(&top);
 	if (err < 0)
 		goto _end;
 	if (!local)
 		goto _skip;
+	pf = NULL;
+	if (local->count > 1) {
+		const char *names[local->count];
+		for (k = 0; k < local->count; ++k)
+			names[k] = local->finfo[k].name;
+		pf = config_prefetch_start(names, local->count);
+	}
 	for (k = 0; k < local->count; ++k) {
 		snd_input_t *in;
-		err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
-		if (err >= 0) {
-			err = snd_config_load(top, in);
-			snd_input_close(in);
+		err = config_prefetch_load(pf, k, top);
+		if (err > 0) {
+			err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
 			if (err < 0) {
-				SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
-				goto _end;
+				SNDERR("cannot access file %s", local->finfo[k].name);
+				continue;
 			}
-		} else {
-			SNDERR("cannot access file %s", local->finfo[k].name);
+			err = config_file_load(top, in, local->finfo[k].name);
+			snd_input_close(in);
+		}
+		if (err < 0) {
+			SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
+			config_prefetch_free(pf);
+			goto _end;
 		}
 	}
+	config_prefetch_free(pf);
  _skip:
 	err = snd_config_hooks(top, NULL);
 	if (err < 0) {
@@ -3884,6 +4979,7 @@ int snd_config_update_free_global(void)
 	if (snd_config)
 		snd_config_delete(snd_config);
 	snd_config = NULL;
+	config_memo_flush();
 	if (snd_config_global_update)
 		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
@@ -3982,21 +5078,23 @@ typedef int (*snd_config_walk_callback_t)(snd_config_t *src,
 					  snd_config_t *root,
 					  snd_config_t **dst,
 					  snd_config_walk_pass_t pass,
-					  snd_config_t *private_data);
+					  snd_config_t *private_data,
+					  struct config_arena *arena);
 #endif
 
 static int snd_config_walk(snd_config_t *src,
 			   snd_config_t *root,
 			   snd_config_t **dst, 
 			   snd_config_walk_callback_t callback,
-			   snd_config_t *private_data)
+			   snd_config_t *private_data,
+			   struct config_arena *arena)
 {
 	int err;
 	snd_config_iterator_t i, next;
 
 	switch (snd_config_get_type(src)) {
 	case SND_CONFIG_TYPE_COMPOUND:
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_PRE, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_PRE, private_data, arena);
 		if (err <= 0)
 			return err;
 		snd_config_for_each(i, next, src) {
@@ -4004,7 +5102,7 @@ static int snd_config_walk(snd_config_t *src,
 			snd_config_t *d = NULL;
 
 			err = snd_config_walk(s, root, (dst && *dst) ? &d : NULL,
-					      callback, private_data);
+					      callback, private_data, arena);
 			if (err < 0)
 				goto _error;
 			if (err && d) {
@@ -4013,7 +5111,7 @@ static int snd_config_walk(snd_config_t *src,
 					goto _error;
 			}
 		}
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_POST, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_POST, private_data, arena);
 		if (err <= 0) {
 		_error:
 			if (dst && *dst)
@@ -4021,7 +5119,7 @@ static int snd_config_walk(snd_config_t *src,
 		}
 		break;
 	default:
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_LEAF, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_LEAF, private_data, arena);
 		break;
 	}
 	return err;
@@ -4031,19 +5129,21 @@ static int _snd_config_copy(snd_config_t *src,
 			    snd_config_t *root ATTRIBUTE_UNUSED,
 			    snd_config_t **dst,
 			    snd_config_walk_pass_t pass,
-			    snd_config_t *private_data ATTRIBUTE_UNUSED)
+			    snd_config_t *private_data ATTRIBUTE_UNUSED,
+			    struct config_arena *arena)
 {
 	int err;
 	const char *id = src->id;
 	snd_config_type_t type = snd_config_get_type(src);
 	switch (pass) {
 	case SND_CONFIG_WALK_PASS_PRE:
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
+		err = config_make_node(dst, id, SND_CONFIG_TYPE_COMPOUND, arena);
 		if (err < 0)
 			return err;
+		(*dst)->u.compound.join = src->u.compound.join;
 		break;
 	case SND_CONFIG_WALK_PASS_LEAF:
-		err = snd_config_make(dst, id, type);
+		err = config_make_node(dst, id, type, arena);
 		if (err < 0)
 			return err;
 		switch (type) {
@@ -4112,14 +5212,26 @@ static int _snd_config_copy(snd_config_t *src,
 int snd_config_copy(snd_config_t **dst,
 		    snd_config_t *src)
 {
-	return snd_config_walk(src, NULL, dst, _snd_config_copy, NULL);
+	struct config_arena *arena;
+	int err;
+
+	/* a single node is not worth an arena */
+	if (src->type != SND_CONFIG_TYPE_COMPOUND)
+		return snd_config_walk(src, NULL, dst, _snd_config_copy, NULL, NULL);
+	arena = config_arena_new();
+	if (!arena)
+		return -ENOMEM;
+	err = snd_config_walk(src, NULL, dst, _snd_config_copy, NULL, arena);
+	config_arena_unref(arena);
+	return err;
 }
 
 static int _snd_config_expand(snd_config_t *src,
 			      snd_config_t *root ATTRIBUTE_UNUSED,
 			      snd_config_t **dst,
 			      snd_config_walk_pass_t pass,
-			      snd_config_t *private_data)
+			      snd_config_t *private_data,
+			      struct config_arena *arena)
 {
 	int err;
 	const char *id = src->id;
@@ -4129,9 +5241,10 @@ static int _snd_config_expand(snd_config_t *src,
 	{
 		if (id && strcmp(id, "@args") == 0)
 			return 0;
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
+		err = config_make_node(dst, id, SND_CONFIG_TYPE_COMPOUND, arena);
 		if (err < 0)
 			return err;
+		(*dst)->u.compound.join = src->u.compound.join;
 		break;
 	}
 	case SND_CONFIG_WALK_PASS_LEAF:
@@ -4141,9 +5254,10 @@ static int _snd_config_expand(snd_config_t *src,
 			long v;
 			err = snd_config_get_integer(src, &v);
 			assert(err >= 0);
-			err = snd_config_imake_integer(dst, id, v);
+			err = config_make_node(dst, id, type, arena);
 			if (err < 0)
 				return err;
+			(*dst)->u.integer = v;
 			break;
 		}
 		case SND_CONFIG_TYPE_INTEGER64:
@@ -4151,9 +5265,10 @@ static int _snd_config_expand(snd_config_t *src,
 			long long v;
 			err = snd_config_get_integer64(src, &v);
 			assert(err >= 0);
-			err = snd_config_imake_integer64(dst, id, v);
+			err = config_make_node(dst, id, type, arena);
 			if (err < 0)
 				return err;
+			(*dst)->u.integer64 = v;
 			break;
 		}
 		case SND_CONFIG_TYPE_REAL:
@@ -4161,9 +5276,10 @@ static int _snd_config_expand(snd_config_t *src,
 			double v;
 			err = snd_config_get_real(src, &v);
 			assert(err >= 0);
-			err = snd_config_imake_real(dst, id, v);
+			err = config_make_node(dst, id, type, arena);
 			if (err < 0)
 				return err;
+			(*dst)->u.real = v;
 			break;
 		}
 		case SND_CONFIG_TYPE_STRING:
@@ -4176,7 +5292,8 @@ static int _snd_config_expand(snd_config_t *src,
 				s++;
 				if (snd_config_search(vars, s, &val) < 0)
 					return 0;
-				err = snd_config_copy(dst, val);
+				err = snd_config_walk(val, NULL, dst, _snd_config_copy,
+						      NULL, arena);
 				if (err < 0)
 					return err;
 				err = snd_config_set_id(*dst, id);
@@ -4185,9 +5302,14 @@ static int _snd_config_expand(snd_config_t *src,
 					return err;
 				}
 			} else {
-				err = snd_config_imake_string(dst, id, s);
+				err = config_make_node(dst, id, type, arena);
 				if (err < 0)
 					return err;
+				err = snd_config_set_string(*dst, s);
+				if (err < 0) {
+					snd_config_delete(*dst);
+					return err;
+				}
 			}
 			break;
 		}
@@ -4201,11 +5323,36 @@ static int _snd_config_expand(snd_config_t *src,
 	return 1;
 }
 
+/* the built-in functions whose result depends only on the tree and
+ * on the environment (which is recorded by snd_config_getenv())
+ */
+static int config_func_memoizable(const char *lib, const char *func_name)
+{
+	static const char *const names[] = {
+		"snd_func_concat",
+		"snd_func_datadir",
+		"snd_func_getenv",
+		"snd_func_iadd",
+		"snd_func_igetenv",
+		"snd_func_imul",
+		"snd_func_refer",
+	};
+	unsigned int k;
+
+	if (lib)
+		return 0;
+	for (k = 0; k < ARRAY_SIZE(names); k++)
+		if (strcmp(func_name, names[k]) == 0)
+			return 1;
+	return 0;
+}
+
 static int _snd_config_evaluate(snd_config_t *src,
 				snd_config_t *root,
 				snd_config_t **dst ATTRIBUTE_UNUSED,
 				snd_config_walk_pass_t pass,
-				snd_config_t *private_data)
+				snd_config_t *private_data,
+				struct config_arena *arena ATTRIBUTE_UNUSED)
 {
 	int err;
 	if (pass == SND_CONFIG_WALK_PASS_PRE) {
@@ -4214,7 +5361,6 @@ static int _snd_config_evaluate(snd_config_t *src,
 		const char *str;
 		int (*func)(snd_config_t **dst, snd_config_t *root,
 			    snd_config_t *src, snd_config_t *private_data) = NULL;
-		void *h = NULL;
 		snd_config_t *c, *func_conf = NULL;
 		err = snd_config_search(src, "@func", &c);
 		if (err < 0)
@@ -4268,29 +5414,20 @@ static int _snd_config_evaluate(snd_config_t *src,
 			buf[len-1] = '\0';
 			func_name = buf;
 		}
-		h = snd_dlopen(lib, RTLD_NOW);
-		if (h)
-			func = snd_dlsym(h, func_name, SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_EVALUATE));
-		err = 0;
-		if (!h) {
-			SNDERR("Cannot open shared library %s", lib);
-			err = -ENOENT;
-			goto _errbuf;
-		} else if (!func) {
-			SNDERR("symbol %s is not defined inside %s", func_name, lib);
-			snd_dlclose(h);
-			err = -ENXIO;
-			goto _errbuf;
-		}
+		func = snd_dlobj_cache_get(lib, func_name,
+			SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_EVALUATE), 1);
+		err = func ? 0 : -errno;
 	       _err:
 		if (func_conf)
 			snd_config_delete(func_conf);
 		if (err >= 0) {
 			snd_config_t *eval;
+			if (config_memo_rec && !config_func_memoizable(lib, func_name))
+				config_memo_rec->uncacheable = 1;
 			err = func(&eval, root, src, private_data);
 			if (err < 0)
 				SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
-			snd_dlclose(h);
+			snd_dlobj_cache_put(func);
 			if (err >= 0 && eval) {
 				/* substitute merges compound members */
 				/* we don't want merging at all */
@@ -4299,7 +5436,6 @@ static int _snd_config_evaluate(snd_config_t *src,
 					err = snd_config_substitute(src, eval);
 			}
 		}
-	       _errbuf:
 		free(buf);
 		if (err < 0)
 			return err;
@@ -4324,7 +5460,7 @@ int snd_config_evaluate(snd_config_t *config, snd_config_t *root,
 {
 	/* FIXME: Only in place evaluation is currently implemented */
 	assert(result == NULL);
-	return snd_config_walk(config, root, result, _snd_config_evaluate, private_data);
+	return snd_config_walk(config, root, result, _snd_config_evaluate, private_data, NULL);
 }
 
 static int load_defaults(snd_config_t *subs, snd_config_t *defs)
@@ -4343,7 +5479,8 @@ static int load_defaults(snd_config_t *subs, snd_config_t *defs)
 			if (strcmp(id, "default") == 0) {
 				snd_config_t *deflt;
 				int err;
-				err = snd_config_copy(&deflt, fld);
+				err = snd_config_walk(fld, NULL, &deflt, _snd_config_copy,
+						      NULL, subs->arena);
 				if (err < 0)
 					return err;
 				err = snd_config_set_id(deflt, def->id);
@@ -4732,6 +5869,7 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 {
 	int err;
 	snd_config_t *defs, *subs = NULL, *res;
+	struct config_arena *arena;
 	err = snd_config_search(config, "@args", &defs);
 	if (err < 0) {
 		if (args != NULL) {
@@ -4742,7 +5880,7 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 		if (err < 0)
 			return err;
 	} else {
-		err = snd_config_top(&subs);
+		err = config_top_arena(&subs);
 		if (err < 0)
 			return err;
 		err = load_defaults(subs, defs);
@@ -4760,7 +5898,13 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 			SNDERR("Args evaluate error: %s", snd_strerror(err));
 			goto _end;
 		}
-		err = snd_config_walk(config, root, &res, _snd_config_expand, subs);
+		arena = config_arena_new();
+		if (!arena) {
+			err = -ENOMEM;
+			goto _end;
+		}
+		err = snd_config_walk(config, root, &res, _snd_config_expand, subs, arena);
+		config_arena_unref(arena);
 		if (err < 0) {
 			SNDERR("Expand error (walk): %s", snd_strerror(err));
 			goto _end;
@@ -4780,6 +5924,211 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+/* getenv() for the evaluate functions; the variables read while a
+ * definition is memoized are stored with it and checked on each reuse
+ */
+const char *snd_config_getenv(const char *name)
+{
+	const char *value = getenv(name);
+	struct config_memo_env *e;
+	size_t len;
+
+	if (!config_memo_rec)
+		return value;
+	len = strlen(name) + 1;
+	e = malloc(sizeof(*e) + len);
+	if (e && value) {
+		e->value = strdup(value);
+		if (!e->value) {
+			free(e);
+			e = NULL;
+		}
+	} else if (e) {
+		e->value = NULL;
+	}
+	if (!e) {
+		config_memo_rec->uncacheable = 1;
+		return value;
+	}
+	memcpy(e->name, name, len);
+	e->next = config_memo_rec->env;
+	config_memo_rec->env = e;
+	return value;
+}
+#endif
+
+static void config_memo_env_free(struct config_memo_env *env)
+{
+	struct config_memo_env *next;
+
+	for (; env; env = next) {
+		next = env->next;
+		free(env->value);
+		free(env);
+	}
+}
+
+static int config_memo_env_copy(struct config_memo_env **dst,
+				const struct config_memo_env *src)
+{
+	struct config_memo_env *e;
+	size_t len;
+
+	for (; src; src = src->next) {
+		len = strlen(src->name) + 1;
+		e = malloc(sizeof(*e) + len);
+		if (!e)
+			return -ENOMEM;
+		e->value = NULL;
+		if (src->value) {
+			e->value = strdup(src->value);
+			if (!e->value) {
+				free(e);
+				return -ENOMEM;
+			}
+		}
+		memcpy(e->name, src->name, len);
+		e->next = *dst;
+		*dst = e;
+	}
+	return 0;
+}
+
+static int config_memo_env_valid(const struct config_memo_env *env)
+{
+	const char *value;
+
+	for (; env; env = env->next) {
+		value = getenv(env->name);
+		if (!value != !env->value)
+			return 0;
+		if (value && strcmp(value, env->value))
+			return 0;
+	}
+	return 1;
+}
+
+static void config_memo_free(struct config_memo *m)
+{
+	list_del(&m->list);
+	config_memo_count--;
+	config_memo_env_free(m->env);
+	snd_config_delete(m->result);
+	free(m->args);
+	free(m);
+}
+
+static void config_memo_flush(void)
+{
+	while (!list_empty(&config_memo_list))
+		config_memo_free(list_entry(config_memo_list.next,
+					    struct config_memo, list));
+	config_memo_generation = config_generation;
+}
+
+static struct config_memo *config_memo_lookup(const snd_config_t *def,
+					      const char *args)
+{
+	struct list_head *pos;
+	struct config_memo *m;
+
+	if (config_memo_generation != config_generation) {
+		config_memo_flush();
+		return NULL;
+	}
+	list_for_each(pos, &config_memo_list) {
+		m = list_entry(pos, struct config_memo, list);
+		if (m->def != def)
+			continue;
+		if (!args != !m->args || (args && strcmp(args, m->args)))
+			continue;
+		if (!config_memo_env_valid(m->env)) {
+			config_memo_free(m);
+			return NULL;
+		}
+		/* keep the most recently used entries first */
+		list_del(&m->list);
+		list_add(&m->list, &config_memo_list);
+		return m;
+	}
+	return NULL;
+}
+
+static void config_memo_store(const snd_config_t *def, const char *args,
+			      const snd_config_t *result,
+			      const struct config_memo_rec *rec)
+{
+	struct config_memo *m;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return;
+	if (args) {
+		m->args = strdup(args);
+		if (!m->args)
+			goto _err;
+	}
+	if (config_memo_env_copy(&m->env, rec->env) < 0)
+		goto _err;
+	if (snd_config_copy(&m->result, (snd_config_t *)result) < 0)
+		goto _err;
+	m->def = def;
+	if (config_memo_count >= CONFIG_MEMO_MAX)
+		config_memo_free(list_entry(config_memo_list.prev,
+					    struct config_memo, list));
+	list_add(&m->list, &config_memo_list);
+	config_memo_count++;
+	return;
+ _err:
+	config_memo_env_free(m->env);
+	free(m->args);
+	free(m);
+}
+
+/*
+ * Expands a definition from the global tree, reusing the result of an
+ * earlier identical expansion.  The key is the definition node, the
+ * arguments and the generation of the global tree, which changes with
+ * every modification of the tree (including snd_config_update()).
+ * Results depending on anything else than the tree and the environment
+ * (card state, external functions) are never stored.
+ */
+static int config_memo_expand(snd_config_t *def, snd_config_t *root,
+			      const char *args, snd_config_t **result)
+{
+	struct config_memo_rec rec = { 0, NULL }, *outer = config_memo_rec;
+	struct config_memo *m;
+	unsigned int generation;
+	snd_config_t *res;
+	int err;
+
+	m = config_memo_lookup(def, args);
+	if (m) {
+		err = snd_config_copy(result, m->result);
+		if (err >= 0 && outer &&
+		    config_memo_env_copy(&outer->env, m->env) < 0)
+			outer->uncacheable = 1;
+		return err;
+	}
+	generation = config_generation;
+	config_memo_rec = &rec;
+	err = snd_config_expand(def, root, args, NULL, &res);
+	config_memo_rec = outer;
+	if (err >= 0) {
+		if (!rec.uncacheable && generation == config_generation)
+			config_memo_store(def, args, res, &rec);
+		*result = res;
+	}
+	if (outer) {
+		outer->uncacheable |= rec.uncacheable;
+		if (config_memo_env_copy(&outer->env, rec.env) < 0)
+			outer->uncacheable = 1;
+	}
+	config_memo_env_free(rec.env);
+	return err;
+}
+
 /**
  * \brief Searches for a definition in a configuration tree, using
  *        aliases and expanding hooks and arguments.
@@ -4800,6 +6149,12 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
  * In any case, \a result is a new node that must be freed by the
  * caller.
  *
+ * When \a config is the global tree #snd_config, the expanded node is
+ * remembered and copied for later searches with the same name, until
+ * the global tree is modified or updated.  Expansions that call
+ * functions depending on the state of cards or on external libraries
+ * are not remembered.
+ *
  * \par Errors:
  * <dl>
  * <dt>-ENOENT<dd>An id in \a key or an alias id does not exist.
@@ -4835,7 +6190,10 @@ int snd_config_search_definition(snd_config_t *config,
 		snd_config_unlock();
 		return err;
 	}
-	err = snd_config_expand(conf, config, args, NULL, result);
+	if (config == snd_config)
+		err = config_memo_expand(conf, config, args, result);
+	else
+		err = snd_config_expand(conf, config, args, NULL, result);
 	snd_config_unlock();
 	return err;
 }
@@ -283,7 +283,7 @@ int snd_func_getenv(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 					err = -EINVAL;
 					goto __error;
 				}
-				res = getenv(ptr);
+				res = snd_config_getenv(ptr);
 				if (res != NULL && *res != '\0')
 					goto __ok;
 				hit = 1;
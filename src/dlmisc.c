@@ -223,12 +223,17 @@ static inline void snd_dlobj_unlock(void) {}
 
 static LIST_HEAD(pcm_dlobj_list);
 
+/*
+ * On failure errno is set to ENOENT when the library cannot be opened,
+ * to ENXIO when it does not define the symbol
+ */
 void *snd_dlobj_cache_get(const char *lib, const char *name,
 			  const char *version, int verbose)
 {
 	struct list_head *p;
 	struct dlobj_cache *c;
 	void *func, *dlobj;
+	int err;
 
 	snd_dlobj_lock();
 	list_for_each(p, &pcm_dlobj_list) {
@@ -253,6 +258,7 @@ void *snd_dlobj_cache_get(const char *lib, const char *name,
 			SNDERR("Cannot open shared library %s",
 						lib ? lib : "[builtin]");
 		snd_dlobj_unlock();
+		errno = ENOENT;
 		return NULL;
 	}
 
@@ -261,8 +267,10 @@ void *snd_dlobj_cache_get(const char *lib, const char *name,
 		if (verbose)
 			SNDERR("symbol %s is not defined inside %s",
 					name, lib ? lib : "[builtin]");
+		err = ENXIO;
 		goto __err;
 	}
+	err = ENOMEM;
 	c = malloc(sizeof(*c));
 	if (! c)
 		goto __err;
@@ -276,6 +284,7 @@ void *snd_dlobj_cache_get(const char *lib, const char *name,
 	      __err:
 		snd_dlclose(dlobj);
 		snd_dlobj_unlock();
+		errno = err;
 		return NULL;
 	}
 	c->dlobj = dlobj;
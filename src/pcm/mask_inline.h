@@ -29,8 +29,19 @@
 #define MASK_OFS(i)	((i) >> 5)
 #define MASK_BIT(i)	(1U << ((i) & 31))
 
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+#define MASK_BUILTINS
+#endif
+
+/* the bits from..to (inclusive) of the word containing them */
+#define MASK_BITS(from, to) \
+	((0xffffffffU << ((from) & 31)) & (0xffffffffU >> (31 - ((to) & 31))))
+
 MASK_INLINE unsigned int ld2(u_int32_t v)
 {
+#ifdef MASK_BUILTINS
+	return v ? 31 - __builtin_clz(v) : 0;
+#else
         unsigned r = 0;
 
         if (v >= 0x10000) {
@@ -52,15 +63,20 @@ MASK_INLINE unsigned int ld2(u_int32_t v)
         if (v >= 2)
                 r++;
         return r;
+#endif
 }
 
 MASK_INLINE unsigned int hweight32(u_int32_t v)
 {
+#if defined(MASK_BUILTINS) && defined(__POPCNT__)
+	return __builtin_popcount(v);
+#else
         v = (v & 0x55555555) + ((v >> 1) & 0x55555555);
         v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
         v = (v & 0x0F0F0F0F) + ((v >> 4) & 0x0F0F0F0F);
         v = (v & 0x00FF00FF) + ((v >> 8) & 0x00FF00FF);
         return (v & 0x0000FFFF) + ((v >> 16) & 0x0000FFFF);
+#endif
 }
 
 MASK_INLINE size_t snd_mask_sizeof(void)
@@ -80,20 +96,20 @@ MASK_INLINE void snd_mask_any(snd_mask_t *mask)
 
 MASK_INLINE int snd_mask_empty(const snd_mask_t *mask)
 {
+	u_int32_t v = 0;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (mask->bits[i])
-			return 0;
-	return 1;
+		v |= mask->bits[i];
+	return !v;
 }
 
 MASK_INLINE int snd_mask_full(const snd_mask_t *mask)
 {
+	u_int32_t v = 0xffffffff;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (mask->bits[i] != 0xffffffff)
-			return 0;
-	return 1;
+		v &= mask->bits[i];
+	return v == 0xffffffff;
 }
 
 MASK_INLINE unsigned int snd_mask_count(const snd_mask_t *mask)
@@ -110,7 +126,11 @@ MASK_INLINE unsigned int snd_mask_min(const snd_mask_t *mask)
 	assert(!snd_mask_empty(mask));
 	for (i = 0; i < MASK_SIZE; i++) {
 		if (mask->bits[i])
+#ifdef MASK_BUILTINS
+			return __builtin_ctz(mask->bits[i]) + (i << 5);
+#else
 			return ffs(mask->bits[i]) - 1 + (i << 5);
+#endif
 	}
 	return 0;
 }
@@ -140,18 +160,34 @@ MASK_INLINE void snd_mask_reset(snd_mask_t *mask, unsigned int val)
 
 MASK_INLINE void snd_mask_set_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
-	unsigned int i;
+	unsigned int i, last;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] |= MASK_BIT(i);
+	i = MASK_OFS(from);
+	last = MASK_OFS(to);
+	if (i == last) {
+		mask->bits[i] |= MASK_BITS(from, to);
+		return;
+	}
+	mask->bits[i++] |= MASK_BITS(from, 31);
+	for (; i < last; i++)
+		mask->bits[i] = 0xffffffff;
+	mask->bits[last] |= MASK_BITS(0, to);
 }
 
 MASK_INLINE void snd_mask_reset_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
-	unsigned int i;
+	unsigned int i, last;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] &= ~MASK_BIT(i);
+	i = MASK_OFS(from);
+	last = MASK_OFS(to);
+	if (i == last) {
+		mask->bits[i] &= ~MASK_BITS(from, to);
+		return;
+	}
+	mask->bits[i++] &= ~MASK_BITS(from, 31);
+	for (; i < last; i++)
+		mask->bits[i] = 0;
+	mask->bits[last] &= ~MASK_BITS(0, to);
 }
 
 MASK_INLINE void snd_mask_leave(snd_mask_t *mask, unsigned int val)
@@ -195,30 +231,31 @@ MASK_INLINE int snd_mask_test(const snd_mask_t *mask, unsigned int val)
 
 MASK_INLINE int snd_mask_single(const snd_mask_t *mask)
 {
-	int i, c = 0;
+	u_int32_t multi = 0;
+	int i, words = 0;
 	assert(!snd_mask_empty(mask));
 	for (i = 0; i < MASK_SIZE; i++) {
-		if (! mask->bits[i])
-			continue;
-		if (mask->bits[i] & (mask->bits[i] - 1))
-			return 0;
-		if (c)
-			return 0;
-		c++;
+		multi |= mask->bits[i] & (mask->bits[i] - 1);
+		words += mask->bits[i] != 0;
 	}
-	return 1;
+	return !multi && words == 1;
 }
 
 MASK_INLINE int snd_mask_refine(snd_mask_t *mask, const snd_mask_t *v)
 {
-	snd_mask_t old;
+	u_int32_t old, changed = 0, left = 0;
+	int i;
 	if (snd_mask_empty(mask))
 		return -ENOENT;
-	snd_mask_copy(&old, mask);
-	snd_mask_intersect(mask, v);
-	if (snd_mask_empty(mask))
+	for (i = 0; i < MASK_SIZE; i++) {
+		old = mask->bits[i];
+		mask->bits[i] = old & v->bits[i];
+		changed |= old ^ mask->bits[i];
+		left |= mask->bits[i];
+	}
+	if (!left)
 		return -EINVAL;
-	return !snd_mask_eq(mask, &old);
+	return changed != 0;
 }
 
 MASK_INLINE int snd_mask_refine_first(snd_mask_t *mask)
@@ -291,9 +328,9 @@ MASK_INLINE int snd_mask_always_eq(const snd_mask_t *m1, const snd_mask_t *m2)
 
 MASK_INLINE int snd_mask_never_eq(const snd_mask_t *m1, const snd_mask_t *m2)
 {
+	u_int32_t v = 0;
 	int i;
 	for (i = 0; i < MASK_SIZE; i++)
-		if (m1->bits[i] & m2->bits[i])
-			return 0;
-	return 1;
+		v |= m1->bits[i] & m2->bits[i];
+	return !v;
 }
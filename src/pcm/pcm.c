@@ -1946,6 +1946,15 @@ int snd_pcm_dump_setup(snd_pcm_t *pcm, snd_output_t *out)
 {
 	snd_pcm_dump_hw_setup(pcm, out);
 	snd_pcm_dump_sw_setup(pcm, out);
+	if (pcm->stats) {
+		snd_output_printf(out, "  --- transfer statistics\n");
+		snd_output_printf(out, "  calls        : %llu\n", pcm->stats->calls);
+		snd_output_printf(out, "  frames       : %llu\n", pcm->stats->frames);
+		snd_output_printf(out, "  total_ns     : %llu\n", pcm->stats->total_ns);
+		snd_output_printf(out, "  self_ns      : %llu\n", pcm->stats->self_ns);
+		snd_output_printf(out, "  max_ns       : %llu\n", pcm->stats->max_ns);
+		snd_output_printf(out, "  cpu_ns       : %llu\n", pcm->stats->cpu_ns);
+	}
 	return 0;
 }
 
@@ -1983,6 +1992,108 @@ int snd_pcm_dump(snd_pcm_t *pcm, snd_output_t *out)
 	return 0;
 }
 
+/**
+ * \brief Get the transfer statistics of a PCM
+ * \param pcm PCM handle
+ * \param stats Returned statistics
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENXIO the statistics are not collected for this PCM
+ *
+ * The statistics are collected when the defaults.pcm.stats
+ * configuration value is set to 1 or when the LIBASOUND_PCM_STATS
+ * environment variable is set.  Every PCM of a plugin chain then
+ * counts the transfers through it; #snd_pcm_dump() shows the
+ * statistics of all the PCMs of the chain.
+ *
+ * The times are measured with CLOCK_MONOTONIC, except the CPU time,
+ * which is the CLOCK_THREAD_CPUTIME_ID time of the calling thread.
+ * Unlike the monotonic clock, the CPU time clock is read with a
+ * system call, so it costs more with small periods.
+ */
+int snd_pcm_get_stats(snd_pcm_t *pcm, snd_pcm_stats_t *stats)
+{
+	assert(pcm && stats);
+	if (!pcm->stats)
+		return -ENXIO;
+	*stats = *pcm->stats;
+	return 0;
+}
+
+/**
+ * \brief Clear the transfer statistics of a PCM
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENXIO the statistics are not collected for this PCM
+ */
+int snd_pcm_reset_stats(snd_pcm_t *pcm)
+{
+	assert(pcm);
+	if (!pcm->stats)
+		return -ENXIO;
+	memset(pcm->stats, 0, sizeof(*pcm->stats));
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+#ifdef HAVE___THREAD
+/* child counter of the innermost transfer of this thread */
+static __thread unsigned long long *stats_outer;
+#endif
+
+static unsigned long long stats_now(clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) < 0)
+		return 0;
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int snd_pcm_stats_enable(snd_pcm_t *pcm)
+{
+	if (pcm->stats)
+		return 0;
+	pcm->stats = calloc(1, sizeof(*pcm->stats));
+	return pcm->stats ? 0 : -ENOMEM;
+}
+
+void snd_pcm_stats_begin(snd_pcm_stats_frame_t *frame)
+{
+	frame->child = 0;
+#ifdef HAVE___THREAD
+	frame->outer = stats_outer;
+	stats_outer = &frame->child;
+#else
+	frame->outer = NULL;
+#endif
+	frame->start_cpu = stats_now(CLOCK_THREAD_CPUTIME_ID);
+	frame->start = stats_now(CLOCK_MONOTONIC);
+}
+
+void snd_pcm_stats_end(snd_pcm_t *pcm, snd_pcm_stats_frame_t *frame,
+		       snd_pcm_sframes_t frames)
+{
+	snd_pcm_stats_t *stats = pcm->stats;
+	unsigned long long ns = stats_now(CLOCK_MONOTONIC) - frame->start;
+	unsigned long long cpu = stats_now(CLOCK_THREAD_CPUTIME_ID);
+
+#ifdef HAVE___THREAD
+	stats_outer = frame->outer;
+#endif
+	if (frame->outer)
+		*frame->outer += ns;
+	stats->calls++;
+	if (frames > 0)
+		stats->frames += frames;
+	stats->total_ns += ns;
+	stats->self_ns += ns > frame->child ? ns - frame->child : 0;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	if (cpu > frame->start_cpu)
+		stats->cpu_ns += cpu - frame->start_cpu;
+}
+#endif
+
 /**
  * \brief Convert bytes in frames for a PCM
  * \param pcm PCM handle
@@ -2243,6 +2354,12 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 		err = snd_config_search(pcm_root, "defaults.pcm.minperiodtime", &tmp);
 		if (err >= 0)
 			snd_config_get_integer(tmp, &(*pcmp)->minperiodtime);
+		err = snd_config_search(pcm_root, "defaults.pcm.stats", &tmp);
+		if (err >= 0) {
+			long i;
+			if (snd_config_get_integer(tmp, &i) >= 0 && i > 0)
+				snd_pcm_stats_enable(*pcmp);
+		}
 		err = 0;
 	}
        _err:
@@ -2342,6 +2459,7 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode)
 {
 	snd_pcm_t *pcm;
+	const char *str;
 	pcm = calloc(1, sizeof(*pcm));
 	if (!pcm)
 		return -ENOMEM;
@@ -2355,6 +2473,9 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 	pcm->op_arg = pcm;
 	pcm->fast_op_arg = pcm;
 	INIT_LIST_HEAD(&pcm->async_handlers);
+	str = getenv("LIBASOUND_PCM_STATS");
+	if (str && *str)
+		snd_pcm_stats_enable(pcm);
 	*pcmp = pcm;
 	return 0;
 }
@@ -2366,6 +2487,8 @@ int snd_pcm_free(snd_pcm_t *pcm)
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
 	snd_dlobj_cache_put(pcm->open_func);
+	snd_pcm_hw_refine_cache_free(pcm);
+	free(pcm->stats);
 	free(pcm);
 	return 0;
 }
@@ -2505,6 +2628,16 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
  */
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm)
 {
+	snd_pcm_sframes_t result;
+
+	/* the capture plugins convert the captured frames here */
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE && pcm->stats) {
+		snd_pcm_stats_frame_t frame;
+		snd_pcm_stats_begin(&frame);
+		result = pcm->fast_ops->avail_update(pcm->fast_op_arg);
+		snd_pcm_stats_end(pcm, &frame, 0);
+		return result;
+	}
 	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
 }
 
@@ -6449,6 +6582,119 @@ snd_pcm_uframes_t snd_pcm_status_get_overrange(const snd_pcm_status_t *obj)
 	return obj->overrange;
 }
 
+/**
+ * \brief get size of #snd_pcm_stats_t
+ * \return size in bytes
+ */
+size_t snd_pcm_stats_sizeof()
+{
+	return sizeof(snd_pcm_stats_t);
+}
+
+/**
+ * \brief allocate an invalid #snd_pcm_stats_t using standard malloc
+ * \param ptr returned pointer
+ * \return 0 on success otherwise negative error code
+ */
+int snd_pcm_stats_malloc(snd_pcm_stats_t **ptr)
+{
+	assert(ptr);
+	*ptr = calloc(1, sizeof(snd_pcm_stats_t));
+	if (!*ptr)
+		return -ENOMEM;
+	return 0;
+}
+
+/**
+ * \brief frees a previously allocated #snd_pcm_stats_t
+ * \param obj pointer to object to free
+ */
+void snd_pcm_stats_free(snd_pcm_stats_t *obj)
+{
+	free(obj);
+}
+
+/**
+ * \brief copy one #snd_pcm_stats_t to another
+ * \param dst pointer to destination
+ * \param src pointer to source
+ */
+void snd_pcm_stats_copy(snd_pcm_stats_t *dst, const snd_pcm_stats_t *src)
+{
+	assert(dst && src);
+	*dst = *src;
+}
+
+/**
+ * \brief Get the count of transfers from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return count of read/write, mmap commit and capture avail_update calls
+ */
+unsigned long long snd_pcm_stats_get_calls(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->calls;
+}
+
+/**
+ * \brief Get the count of transferred frames from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return count of frames
+ */
+unsigned long long snd_pcm_stats_get_frames(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->frames;
+}
+
+/**
+ * \brief Get the time spent in the transfers from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return time in nanoseconds, including the slave PCMs
+ */
+unsigned long long snd_pcm_stats_get_total_ns(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->total_ns;
+}
+
+/**
+ * \brief Get the time spent in the PCM itself from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return time in nanoseconds, without the transfers of the slave PCMs
+ */
+unsigned long long snd_pcm_stats_get_self_ns(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->self_ns;
+}
+
+/**
+ * \brief Get the longest transfer from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return time in nanoseconds, including the slave PCMs
+ */
+unsigned long long snd_pcm_stats_get_max_ns(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->max_ns;
+}
+
+/**
+ * \brief Get the CPU time of the transfers from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return CPU time of the calling threads in nanoseconds, including the
+ *         slave PCMs
+ *
+ * Unlike the other times, the CPU time does not count the time the
+ * thread was sleeping or waiting to be scheduled.
+ */
+unsigned long long snd_pcm_stats_get_cpu_ns(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->cpu_ns;
+}
+
 /**
  * \brief get size of #snd_pcm_info_t
  * \return size in bytes
@@ -6761,6 +7007,8 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 				      snd_pcm_uframes_t offset,
 				      snd_pcm_uframes_t frames)
 {
+	snd_pcm_sframes_t result;
+
 	assert(pcm);
 	if (CHECK_SANITY(offset != *pcm->appl.ptr % pcm->buffer_size)) {
 		SNDMSG("commit offset (%ld) doesn't match with appl_ptr (%ld) %% buf_size (%ld)",
@@ -6772,7 +7020,9 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 		       snd_pcm_mmap_avail(pcm));
 		return -EPIPE;
 	}
-	return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
+	SND_PCM_STATS_CALL(pcm, result,
+		pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames));
+	return result;
 }
 
 #ifndef DOC_HIDDEN
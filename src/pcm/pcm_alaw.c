@@ -440,6 +440,7 @@ int snd_pcm_alaw_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sform
 	alaw->plug.write = snd_pcm_alaw_write_areas;
 	alaw->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	alaw->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	alaw->plug.fuse = 1;
 	alaw->plug.gen.slave = slave;
 	alaw->plug.gen.close_slave = close_slave;
 
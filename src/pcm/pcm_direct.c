@@ -51,11 +51,6 @@ union semun {
 	struct seminfo  *__buf;  /* Buffer for IPC_INFO (Linux specific) */
 };
  
-/*
- * FIXME:
- *  add possibility to use futexes here
- */
-
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 {
 	union semun s;
@@ -82,6 +77,27 @@ int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+#ifdef DIRECT_MIX_FUTEX
+/*
+ * The first client sets up the mix lock, the others are serialized by
+ * the client semaphore until then.  Without robust process shared
+ * mutexes the mixing falls back to the semaphore.
+ */
+void snd_pcm_direct_mix_lock_attach(snd_pcm_direct_t *dmix, int first)
+{
+	pthread_mutexattr_t attr;
+
+	if (!first || !dmix->shmptr->u.dmix.futex)
+		return;
+	if (pthread_mutexattr_init(&attr) ||
+	    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) ||
+	    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) ||
+	    pthread_mutex_init(&dmix->shmptr->u.dmix.mix_lock, &attr))
+		dmix->shmptr->u.dmix.futex = 0;
+	pthread_mutexattr_destroy(&attr);
+}
+#endif
+
 #define SND_PCM_DIRECT_MAGIC	(0xa15ad300 + sizeof(snd_pcm_direct_share_t))
 
 /*
@@ -513,9 +529,19 @@ int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid)
 	return snd_timer_async(dmix->timer, sig, pid);
 }
 
+/* the slave period the hardware pointer is in, -1 when unknown */
+static snd_pcm_uframes_t slave_timer_period(snd_pcm_direct_t *dmix)
+{
+	if (! dmix->spcm || ! dmix->spcm->hw.ptr || ! dmix->slave_period_size)
+		return (snd_pcm_uframes_t)-1;
+	return *dmix->spcm->hw.ptr / dmix->slave_period_size;
+}
+
 /* empty the timer read queue */
 void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 {
+	/* sampled before the reads, a tick racing with them is not lost */
+	dmix->timer_period = slave_timer_period(dmix);
 	if (dmix->timer_need_poll) {
 		while (poll(&dmix->timer_fd, 1, 0) > 0) {
 			/* we don't need the value */
@@ -543,6 +569,24 @@ void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 	}
 }
 
+/*
+ * empty the timer read queue unless no period elapsed since the last drain
+ *
+ * The timer ticks once per slave period, so while the slave hw_ptr stays
+ * in the period seen at the last drain the queue is empty and the reads
+ * can be saved; every client calls this after each transfer.  A tick
+ * missed here (e.g. the early event of a just started timer) costs one
+ * spurious wakeup, snd_pcm_direct_poll_revents() drains the queue then.
+ */
+void snd_pcm_direct_check_timer_queue(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_uframes_t period = slave_timer_period(dmix);
+
+	if (period != (snd_pcm_uframes_t)-1 && period == dmix->timer_period)
+		return;
+	snd_pcm_direct_clear_timer_queue(dmix);
+}
+
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
 {
 	snd_timer_stop(dmix->timer);
@@ -938,6 +982,7 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			SND_PCM_FORMAT_S16 ^ SND_PCM_FORMAT_S16_LE ^ SND_PCM_FORMAT_S16_BE,
 			SND_PCM_FORMAT_S24_LE,
 			SND_PCM_FORMAT_S24_3LE,
+			SND_PCM_FORMAT_FLOAT,
 			SND_PCM_FORMAT_U8,
 		};
 		snd_pcm_format_t format;
@@ -1146,6 +1191,7 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 
 	dmix->tread = 1;
 	dmix->timer_need_poll = 0;
+	dmix->timer_period = (snd_pcm_uframes_t)-1;
 	snd_pcm_info_alloca(&info);
 	ret = snd_pcm_info(dmix->spcm, info);
 	if (ret < 0) {
@@ -1619,6 +1665,8 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 	rec->ipc_gid = -1;
 	rec->slowptr = 1;
 	rec->max_periods = 0;
+	rec->lockless = 0;
+	rec->futex = 1;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -1725,6 +1773,20 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->max_periods = val;
 			continue;
 		}
+		if (strcmp(id, "lockless") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->lockless = err;
+			continue;
+		}
+		if (strcmp(id, "futex") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->futex = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1732,6 +1794,17 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 		SNDERR("slave is not defined");
 		return -EINVAL;
 	}
+	if (rec->lockless) {
+		const char *type = NULL;
+
+		/* only dmix mixes, dsnoop and dshare have nothing to lock */
+		if (snd_config_search(conf, "type", &n) >= 0)
+			snd_config_get_string(n, &type);
+		if (!type || strcmp(type, "dmix")) {
+			SNDERR("The field lockless is supported only by dmix");
+			return -EINVAL;
+		}
+	}
 	if (!rec->ipc_key) {
 		SNDERR("Unique IPC key is not defined");
 		return -EINVAL;
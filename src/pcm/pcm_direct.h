@@ -24,6 +24,11 @@
 #define DIRECT_IPC_SEMS         1
 #define DIRECT_IPC_SEM_CLIENT   0
 
+#if defined(__linux__) && defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define DIRECT_MIX_FUTEX	1	/* the mixing can be serialized by a futex */
+#endif
+
 typedef void (mix_areas_t)(unsigned int size,
 			   volatile void *dst, void *src,
 			   volatile signed int *sum, size_t dst_step,
@@ -49,6 +54,11 @@ typedef void (mix_areas_u8_t)(unsigned int size,
 			      volatile signed int *sum, size_t dst_step,
 			      size_t src_step, size_t sum_step);
 
+typedef void (mix_areas_float_t)(unsigned int size,
+				 volatile float *dst, float *src,
+				 volatile float *sum, size_t dst_step,
+				 size_t src_step, size_t sum_step);
+
 struct slave_params {
 	snd_pcm_format_t format;
 	int rate;
@@ -111,6 +121,13 @@ typedef struct {
 		struct {
 			unsigned long long chn_mask;
 		} dshare;
+		struct {
+			unsigned int lockless;	/* mix with atomic ops, no semaphore */
+			unsigned int futex;	/* mix_lock serializes the mixing */
+#ifdef DIRECT_MIX_FUTEX
+			pthread_mutex_t mix_lock; /* robust, process shared */
+#endif
+		} dmix;
 	} u;
 } snd_pcm_direct_share_t;
 
@@ -147,6 +164,7 @@ struct snd_pcm_direct {
 	int tread: 1;
 	int timer_need_poll: 1;
 	unsigned int timer_events;
+	snd_pcm_uframes_t timer_period;	/* slave period of the last queue drain */
 	int server_fd;
 	pid_t server_pid;
 	snd_timer_t *timer; 		/* timer used as poll_fd */
@@ -158,7 +176,8 @@ struct snd_pcm_direct {
 	union {
 		struct {
 			int shmid_sum;			/* IPC global sum ring buffer memory identification */
-			signed int *sum_buffer;		/* shared sum buffer */
+			signed int *sum_buffer;		/* shared sum buffer (float for FLOAT format) */
+			int use_sem;			/* mixing is serialized by DIRECT_IPC_SEM_CLIENT */
 			mix_areas_16_t *mix_areas_16;
 			mix_areas_32_t *mix_areas_32;
 			mix_areas_24_t *mix_areas_24;
@@ -167,6 +186,8 @@ struct snd_pcm_direct {
 			mix_areas_32_t *remix_areas_32;
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
+			mix_areas_float_t *mix_areas_float;
+			mix_areas_float_t *remix_areas_float;
 		} dmix;
 		struct {
 		} dsnoop;
@@ -180,6 +201,12 @@ struct snd_pcm_direct {
 /* make local functions really local */
 #define snd_pcm_direct_semaphore_create_or_connect \
 	snd1_pcm_direct_semaphore_create_or_connect
+#define snd_pcm_direct_mix_lock_attach \
+	snd1_pcm_direct_mix_lock_attach
+#define snd_pcm_direct_mix_lock_wait \
+	snd1_pcm_direct_mix_lock_wait
+#define snd_pcm_direct_mix_unlock_wake \
+	snd1_pcm_direct_mix_unlock_wake
 #define snd_pcm_direct_shm_create_or_connect \
 	snd1_pcm_direct_shm_create_or_connect
 #define snd_pcm_direct_shm_discard \
@@ -232,6 +259,8 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_timer_stop
 #define snd_pcm_direct_clear_timer_queue \
 	snd1_pcm_direct_clear_timer_queue
+#define snd_pcm_direct_check_timer_queue \
+	snd1_pcm_direct_check_timer_queue
 #define snd_pcm_direct_set_timer_params \
 	snd1_pcm_direct_set_timer_params
 #define snd_pcm_direct_open_secondary_client \
@@ -282,6 +311,28 @@ static inline int snd_pcm_direct_semaphore_final(snd_pcm_direct_t *dmix, int sem
 	return snd_pcm_direct_semaphore_up(dmix, sem_num);
 }
 
+#ifdef DIRECT_MIX_FUTEX
+void snd_pcm_direct_mix_lock_attach(snd_pcm_direct_t *dmix, int first);
+
+/*
+ * the mix lock lives in the shared memory and takes no system call
+ * unless it is contended; it is a robust futex, so the kernel hands
+ * the lock of a dead holder to the next client
+ */
+static inline void snd_pcm_direct_mix_lock(snd_pcm_direct_t *dmix)
+{
+	pthread_mutex_t *lock = &dmix->shmptr->u.dmix.mix_lock;
+
+	if (pthread_mutex_lock(lock) == EOWNERDEAD)
+		pthread_mutex_consistent(lock);
+}
+
+static inline void snd_pcm_direct_mix_unlock(snd_pcm_direct_t *dmix)
+{
+	pthread_mutex_unlock(&dmix->shmptr->u.dmix.mix_lock);
+}
+#endif
+
 int snd_pcm_direct_shm_create_or_connect(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix);
@@ -310,6 +361,7 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm);
 int snd_pcm_direct_resume(snd_pcm_t *pcm);
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix);
 void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_check_timer_queue(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_open_secondary_client(snd_pcm_t **spcmp, snd_pcm_direct_t *dmix, const char *client_name);
 
@@ -326,6 +378,8 @@ struct snd_pcm_direct_open_conf {
 	int ipc_gid;
 	int slowptr;
 	int max_periods;
+	int lockless;
+	int futex;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
@@ -140,15 +140,22 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
  */
 
 #include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
 #if defined(__i386__)
 #include "pcm_dmix_i386.c"
 #elif defined(__x86_64__)
 #include "pcm_dmix_x86_64.c"
 #else
 #ifndef DOC_HIDDEN
-#define mix_select_callbacks(x)	generic_mix_select_callbacks(x)
 #define dmix_supported_format generic_dmix_supported_format
 #endif
+
+static void mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	generic_mix_select_callbacks(dmix);
+	if (dmix->u.dmix.use_sem)
+		simd_mix_select_callbacks(dmix);
+}
 #endif
 
 static void mix_areas(snd_pcm_direct_t *dmix,
@@ -186,6 +193,10 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -254,6 +265,10 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -289,17 +304,34 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 
 /*
  * if no concurrent access is allowed in the mixing routines, we need to protect
- * the area via semaphore
+ * the area via semaphore or the futex in the shared memory; the lockless mode
+ * uses atomic mixing code instead
  */
-#ifndef DOC_HIDDEN
-#ifdef NO_CONCURRENT_ACCESS
-#define dmix_down_sem(dmix) snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT)
-#define dmix_up_sem(dmix) snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT)
-#else
-#define dmix_down_sem(dmix)
-#define dmix_up_sem(dmix)
+static inline void dmix_down_sem(snd_pcm_direct_t *dmix)
+{
+	if (!dmix->u.dmix.use_sem)
+		return;
+#ifdef DIRECT_MIX_FUTEX
+	if (dmix->shmptr->u.dmix.futex) {
+		snd_pcm_direct_mix_lock(dmix);
+		return;
+	}
 #endif
+	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
+static inline void dmix_up_sem(snd_pcm_direct_t *dmix)
+{
+	if (!dmix->u.dmix.use_sem)
+		return;
+#ifdef DIRECT_MIX_FUTEX
+	if (dmix->shmptr->u.dmix.futex) {
+		snd_pcm_direct_mix_unlock(dmix);
+		return;
+	}
 #endif
+	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+}
 
 /*
  *  synchronize shm ring buffer with hardware
@@ -562,6 +594,7 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 
 	snd_pcm_hwsync(dmix->spcm);
 	reset_slave_ptr(pcm, dmix);
+	dmix->timer_period = (snd_pcm_uframes_t)-1;
 	err = snd_timer_start(dmix->timer);
 	if (err < 0)
 		return err;
@@ -828,7 +861,7 @@ static snd_pcm_sframes_t snd_pcm_dmix_mmap_commit(snd_pcm_t *pcm,
 		snd_pcm_dmix_sync_area(pcm);
 		/* clear timer queue to avoid a bogus return from poll */
 		if (snd_pcm_mmap_playback_avail(pcm) < pcm->avail_min)
-			snd_pcm_direct_clear_timer_queue(dmix);
+			snd_pcm_direct_check_timer_queue(dmix);
 	}
 	return size;
 }
@@ -1044,6 +1077,11 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 
 		dmix->spcm = spcm;
 
+		dmix->shmptr->u.dmix.lockless = opts->lockless;
+#ifdef DIRECT_MIX_FUTEX
+		dmix->shmptr->u.dmix.futex = opts->futex;
+#endif
+
 		if (dmix->shmptr->use_server) {
 			dmix->server_free = dmix_server_free;
 		
@@ -1095,6 +1133,10 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		dmix->spcm = spcm;
 	}
 
+#ifdef DIRECT_MIX_FUTEX
+	snd_pcm_direct_mix_lock_attach(dmix, first_instance);
+#endif
+
 	ret = shm_sum_create_or_connect(dmix);
 	if (ret < 0) {
 		SNDERR("unable to initialize sum ring buffer");
@@ -1157,6 +1199,15 @@ This plugin provides direct mixing of multiple streams. The resolution
 for 32-bit mixing is only 24-bit. The low significant byte is filled with
 zeros. The extra 8 bits are used for the saturation.
 
+When the slave format is \c FLOAT (native endian), the sum buffer holds
+floats and the streams are mixed without the integer conversion. The
+result is saturated to the range -1.0 .. 1.0 when it's written to the
+slave buffer, so float clients can be connected without an additional
+lfloat conversion.  The float sum buffer is used only for a \c FLOAT
+slave; with an integer slave format the float clients are converted and
+mixed as integers like before.  \c FLOAT is tried after the integer
+formats when the slave format is not given.
+
 \code
 pcm.name {
 	type dmix		# Direct mix
@@ -1184,6 +1235,8 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	lockless BOOL		# mix with atomic operations (no semaphore)
+	futex BOOL		# serialize the mixing with a futex (default yes)
 }
 \endcode
 
@@ -1195,6 +1248,23 @@ added to the value set in <code>ipc_key</code>.  This will
 avoid the confliction of the same IPC key with different users
 concurrently.
 
+When <code>lockless</code> is set true, the clients mix into the shared
+buffers with atomic operations instead of serializing the mixing via the
+IPC semaphore, so that no system call is issued per commit.  This mode
+is available only for the formats with atomic mixing code (native endian
+S16 and S32, and the 24-bit formats on x86); the other formats still use
+the semaphore.  The value
+is taken from the client which creates the shared memory, the other
+clients follow it.
+
+The mixing which is not lockless is serialized by a robust process
+shared mutex in the shared memory on Linux, which costs no system call
+unless two clients mix at the same time.  The kernel releases the lock
+of a crashed client like it does for the semaphore.  Set
+<code>futex</code> false to use the IPC semaphore instead.  Like
+<code>lockless</code>, the value is taken from the client which creates
+the shared memory.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
@@ -0,0 +1,416 @@
+/*
+ * vectorized mixing code (SSE2, AVX2, NEON)
+ *
+ * These routines are not atomic: they read the sum and the destination,
+ * compute a whole vector and store it back.  They are valid only while
+ * the mixing is serialized by the DIRECT_IPC_SEM_CLIENT semaphore.
+ * Only the native endian S16, S32 and FLOAT formats are covered; the areas
+ * must be contiguous (interleaved buffer), otherwise the generic code is used.
+ */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define DMIX_SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DMIX_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(DMIX_SIMD_X86) || defined(DMIX_SIMD_NEON)
+
+#define simd_contiguous(dst_step, src_step, sum_step, ssize) \
+	((dst_step) == (ssize) && (src_step) == (ssize) && \
+	 (sum_step) == sizeof(signed int))
+
+#endif
+
+#ifdef DMIX_SIMD_X86
+
+/*
+ *  SSE2
+ */
+
+/* saturate the 24-bit sum and scale it back to 32-bit */
+static inline __attribute__((target("sse2")))
+__m128i sse2_sat_s24_to_s32(__m128i v)
+{
+	__m128i gt = _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7fffff));
+	__m128i lt = _mm_cmplt_epi32(v, _mm_set1_epi32(-0x800000));
+
+	v = _mm_andnot_si128(_mm_or_si128(gt, lt), _mm_slli_epi32(v, 8));
+	v = _mm_or_si128(v, _mm_and_si128(gt, _mm_set1_epi32(0x7fffffff)));
+	return _mm_or_si128(v, _mm_and_si128(lt, _mm_set1_epi32(0x80000000)));
+}
+
+/* the same for 8 samples: sum = (dst ? sum : 0) + sign * src */
+#define SSE2_MIX_16(name, op, scalar)					\
+static void __attribute__((target("sse2")))				\
+name(unsigned int size, volatile signed short *dst, signed short *src,	\
+     volatile signed int *sum, size_t dst_step, size_t src_step,	\
+     size_t sum_step)							\
+{									\
+	signed short *d = (signed short *)dst;				\
+	signed int *s = (signed int *)sum;				\
+	const __m128i zero = _mm_setzero_si128();			\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 2)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8, src += 8, d += 8, s += 8) {	\
+		__m128i vsrc = _mm_loadu_si128((__m128i *)src);		\
+		__m128i vdst = _mm_loadu_si128((__m128i *)d);		\
+		__m128i mask = _mm_cmpeq_epi16(vdst, zero);		\
+		__m128i src_lo = _mm_srai_epi32(_mm_unpacklo_epi16(vsrc, vsrc), 16); \
+		__m128i src_hi = _mm_srai_epi32(_mm_unpackhi_epi16(vsrc, vsrc), 16); \
+		__m128i mask_lo = _mm_unpacklo_epi16(mask, mask);	\
+		__m128i mask_hi = _mm_unpackhi_epi16(mask, mask);	\
+		__m128i sum_lo = _mm_andnot_si128(mask_lo, _mm_loadu_si128((__m128i *)s)); \
+		__m128i sum_hi = _mm_andnot_si128(mask_hi, _mm_loadu_si128((__m128i *)(s + 4))); \
+		sum_lo = op(sum_lo, src_lo);				\
+		sum_hi = op(sum_hi, src_hi);				\
+		_mm_storeu_si128((__m128i *)s, sum_lo);			\
+		_mm_storeu_si128((__m128i *)(s + 4), sum_hi);		\
+		_mm_storeu_si128((__m128i *)d, _mm_packs_epi32(sum_lo, sum_hi)); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+#define SSE2_MIX_32(name, op, scalar, remix)				\
+static void __attribute__((target("sse2")))				\
+name(unsigned int size, volatile signed int *dst, signed int *src,	\
+     volatile signed int *sum, size_t dst_step, size_t src_step,	\
+     size_t sum_step)							\
+{									\
+	signed int *d = (signed int *)dst;				\
+	signed int *s = (signed int *)sum;				\
+	const __m128i zero = _mm_setzero_si128();			\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4, src += 4, d += 4, s += 4) {	\
+		__m128i vsrc = _mm_loadu_si128((__m128i *)src);		\
+		__m128i mask = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)d), zero); \
+		__m128i vsum = _mm_andnot_si128(mask, _mm_loadu_si128((__m128i *)s)); \
+		vsum = op(vsum, _mm_srai_epi32(vsrc, 8));		\
+		_mm_storeu_si128((__m128i *)s, vsum);			\
+		if (remix)						\
+			vsrc = _mm_sub_epi32(zero, vsrc);		\
+		_mm_storeu_si128((__m128i *)d,				\
+			_mm_or_si128(_mm_and_si128(mask, vsrc),		\
+				     _mm_andnot_si128(mask, sse2_sat_s24_to_s32(vsum)))); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+SSE2_MIX_16(sse2_mix_areas_16, _mm_add_epi32, generic_mix_areas_16_native)
+SSE2_MIX_16(sse2_remix_areas_16, _mm_sub_epi32, generic_remix_areas_16_native)
+SSE2_MIX_32(sse2_mix_areas_32, _mm_add_epi32, generic_mix_areas_32_native, 0)
+SSE2_MIX_32(sse2_remix_areas_32, _mm_sub_epi32, generic_remix_areas_32_native, 1)
+
+#define SSE2_MIX_FLOAT(name, op, scalar, remix)				\
+static void __attribute__((target("sse2")))				\
+name(unsigned int size, volatile float *dst, float *src,		\
+     volatile float *sum, size_t dst_step, size_t src_step,		\
+     size_t sum_step)							\
+{									\
+	float *d = (float *)dst;					\
+	float *s = (float *)sum;					\
+	const __m128 zero = _mm_setzero_ps();				\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4, src += 4, d += 4, s += 4) {	\
+		__m128 vsrc = _mm_loadu_ps(src);			\
+		__m128 mask = _mm_cmpeq_ps(_mm_loadu_ps(d), zero);	\
+		__m128 vsum = op(_mm_andnot_ps(mask, _mm_loadu_ps(s)), vsrc); \
+		_mm_storeu_ps(s, vsum);					\
+		if (remix)						\
+			vsrc = _mm_sub_ps(zero, vsrc);			\
+		vsum = _mm_min_ps(_mm_max_ps(vsum, _mm_set1_ps(-1.0f)),	\
+				  _mm_set1_ps(1.0f));			\
+		_mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(mask, vsrc),	\
+					   _mm_andnot_ps(mask, vsum)));	\
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+SSE2_MIX_FLOAT(sse2_mix_areas_float, _mm_add_ps, generic_mix_areas_float, 0)
+SSE2_MIX_FLOAT(sse2_remix_areas_float, _mm_sub_ps, generic_remix_areas_float, 1)
+
+/*
+ *  AVX2
+ */
+
+static inline __attribute__((target("avx2")))
+__m256i avx2_sat_s24_to_s32(__m256i v)
+{
+	__m256i gt = _mm256_cmpgt_epi32(v, _mm256_set1_epi32(0x7fffff));
+	__m256i lt = _mm256_cmpgt_epi32(_mm256_set1_epi32(-0x800000), v);
+
+	v = _mm256_slli_epi32(v, 8);
+	v = _mm256_blendv_epi8(v, _mm256_set1_epi32(0x7fffffff), gt);
+	return _mm256_blendv_epi8(v, _mm256_set1_epi32(0x80000000), lt);
+}
+
+#define AVX2_MIX_16(name, op, scalar)					\
+static void __attribute__((target("avx2")))				\
+name(unsigned int size, volatile signed short *dst, signed short *src,	\
+     volatile signed int *sum, size_t dst_step, size_t src_step,	\
+     size_t sum_step)							\
+{									\
+	signed short *d = (signed short *)dst;				\
+	signed int *s = (signed int *)sum;				\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 2)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 16; size -= 16, src += 16, d += 16, s += 16) {	\
+		__m128i vdst_lo = _mm_loadu_si128((__m128i *)d);	\
+		__m128i vdst_hi = _mm_loadu_si128((__m128i *)(d + 8));	\
+		__m256i src_lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *)src)); \
+		__m256i src_hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *)(src + 8))); \
+		__m256i mask_lo = _mm256_cvtepi16_epi32(_mm_cmpeq_epi16(vdst_lo, _mm_setzero_si128())); \
+		__m256i mask_hi = _mm256_cvtepi16_epi32(_mm_cmpeq_epi16(vdst_hi, _mm_setzero_si128())); \
+		__m256i sum_lo = _mm256_andnot_si256(mask_lo, _mm256_loadu_si256((__m256i *)s)); \
+		__m256i sum_hi = _mm256_andnot_si256(mask_hi, _mm256_loadu_si256((__m256i *)(s + 8))); \
+		sum_lo = op(sum_lo, src_lo);				\
+		sum_hi = op(sum_hi, src_hi);				\
+		_mm256_storeu_si256((__m256i *)s, sum_lo);		\
+		_mm256_storeu_si256((__m256i *)(s + 8), sum_hi);	\
+		/* packs works per 128-bit lane, restore the sample order */ \
+		_mm256_storeu_si256((__m256i *)d,			\
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(sum_lo, sum_hi), 0xd8)); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+#define AVX2_MIX_32(name, op, scalar, remix)				\
+static void __attribute__((target("avx2")))				\
+name(unsigned int size, volatile signed int *dst, signed int *src,	\
+     volatile signed int *sum, size_t dst_step, size_t src_step,	\
+     size_t sum_step)							\
+{									\
+	signed int *d = (signed int *)dst;				\
+	signed int *s = (signed int *)sum;				\
+	const __m256i zero = _mm256_setzero_si256();			\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8, src += 8, d += 8, s += 8) {	\
+		__m256i vsrc = _mm256_loadu_si256((__m256i *)src);	\
+		__m256i mask = _mm256_cmpeq_epi32(_mm256_loadu_si256((__m256i *)d), zero); \
+		__m256i vsum = _mm256_andnot_si256(mask, _mm256_loadu_si256((__m256i *)s)); \
+		vsum = op(vsum, _mm256_srai_epi32(vsrc, 8));		\
+		_mm256_storeu_si256((__m256i *)s, vsum);		\
+		if (remix)						\
+			vsrc = _mm256_sub_epi32(zero, vsrc);		\
+		_mm256_storeu_si256((__m256i *)d,			\
+			_mm256_blendv_epi8(avx2_sat_s24_to_s32(vsum), vsrc, mask)); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+AVX2_MIX_16(avx2_mix_areas_16, _mm256_add_epi32, generic_mix_areas_16_native)
+AVX2_MIX_16(avx2_remix_areas_16, _mm256_sub_epi32, generic_remix_areas_16_native)
+AVX2_MIX_32(avx2_mix_areas_32, _mm256_add_epi32, generic_mix_areas_32_native, 0)
+AVX2_MIX_32(avx2_remix_areas_32, _mm256_sub_epi32, generic_remix_areas_32_native, 1)
+
+#define AVX2_MIX_FLOAT(name, op, scalar, remix)				\
+static void __attribute__((target("avx2")))				\
+name(unsigned int size, volatile float *dst, float *src,		\
+     volatile float *sum, size_t dst_step, size_t src_step,		\
+     size_t sum_step)							\
+{									\
+	float *d = (float *)dst;					\
+	float *s = (float *)sum;					\
+	const __m256 zero = _mm256_setzero_ps();			\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8, src += 8, d += 8, s += 8) {	\
+		__m256 vsrc = _mm256_loadu_ps(src);			\
+		__m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(d), zero, _CMP_EQ_OQ); \
+		__m256 vsum = op(_mm256_andnot_ps(mask, _mm256_loadu_ps(s)), vsrc); \
+		_mm256_storeu_ps(s, vsum);				\
+		if (remix)						\
+			vsrc = _mm256_sub_ps(zero, vsrc);		\
+		vsum = _mm256_min_ps(_mm256_max_ps(vsum, _mm256_set1_ps(-1.0f)), \
+				     _mm256_set1_ps(1.0f));		\
+		_mm256_storeu_ps(d, _mm256_blendv_ps(vsum, vsrc, mask)); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+AVX2_MIX_FLOAT(avx2_mix_areas_float, _mm256_add_ps, generic_mix_areas_float, 0)
+AVX2_MIX_FLOAT(avx2_remix_areas_float, _mm256_sub_ps, generic_remix_areas_float, 1)
+
+#endif /* DMIX_SIMD_X86 */
+
+#ifdef DMIX_SIMD_NEON
+
+static inline int32x4_t neon_sat_s24_to_s32(int32x4_t v)
+{
+	uint32x4_t gt = vcgtq_s32(v, vdupq_n_s32(0x7fffff));
+	uint32x4_t lt = vcltq_s32(v, vdupq_n_s32(-0x800000));
+
+	v = vshlq_n_s32(v, 8);
+	v = vbslq_s32(gt, vdupq_n_s32(0x7fffffff), v);
+	return vbslq_s32(lt, vdupq_n_s32(-0x7fffffff - 1), v);
+}
+
+/* widen the low/high half of a 16-bit lane mask to 32-bit lanes */
+#define neon_mask_lo(m)	vreinterpretq_s32_s16(vzipq_s16(m, m).val[0])
+#define neon_mask_hi(m)	vreinterpretq_s32_s16(vzipq_s16(m, m).val[1])
+
+#define NEON_MIX_16(name, op, scalar)					\
+static void name(unsigned int size, volatile signed short *dst,		\
+		 signed short *src, volatile signed int *sum,		\
+		 size_t dst_step, size_t src_step, size_t sum_step)	\
+{									\
+	signed short *d = (signed short *)dst;				\
+	signed int *s = (signed int *)sum;				\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 2)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8, src += 8, d += 8, s += 8) {	\
+		int16x8_t vsrc = vld1q_s16(src);			\
+		int16x8_t mask = vreinterpretq_s16_u16(vceqq_s16(vld1q_s16(d), vdupq_n_s16(0))); \
+		int32x4_t sum_lo = vbicq_s32(vld1q_s32(s), neon_mask_lo(mask)); \
+		int32x4_t sum_hi = vbicq_s32(vld1q_s32(s + 4), neon_mask_hi(mask)); \
+		sum_lo = op(sum_lo, vmovl_s16(vget_low_s16(vsrc)));	\
+		sum_hi = op(sum_hi, vmovl_s16(vget_high_s16(vsrc)));	\
+		vst1q_s32(s, sum_lo);					\
+		vst1q_s32(s + 4, sum_hi);				\
+		vst1q_s16(d, vcombine_s16(vqmovn_s32(sum_lo), vqmovn_s32(sum_hi))); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+#define NEON_MIX_32(name, op, scalar, remix)				\
+static void name(unsigned int size, volatile signed int *dst,		\
+		 signed int *src, volatile signed int *sum,		\
+		 size_t dst_step, size_t src_step, size_t sum_step)	\
+{									\
+	signed int *d = (signed int *)dst;				\
+	signed int *s = (signed int *)sum;				\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4, src += 4, d += 4, s += 4) {	\
+		int32x4_t vsrc = vld1q_s32(src);			\
+		uint32x4_t mask = vceqq_s32(vld1q_s32(d), vdupq_n_s32(0)); \
+		int32x4_t vsum = vbicq_s32(vld1q_s32(s), vreinterpretq_s32_u32(mask)); \
+		vsum = op(vsum, vshrq_n_s32(vsrc, 8));			\
+		vst1q_s32(s, vsum);					\
+		if (remix)						\
+			vsrc = vnegq_s32(vsrc);				\
+		vst1q_s32(d, vbslq_s32(mask, vsrc, neon_sat_s24_to_s32(vsum))); \
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+NEON_MIX_16(neon_mix_areas_16, vaddq_s32, generic_mix_areas_16_native)
+NEON_MIX_16(neon_remix_areas_16, vsubq_s32, generic_remix_areas_16_native)
+NEON_MIX_32(neon_mix_areas_32, vaddq_s32, generic_mix_areas_32_native, 0)
+NEON_MIX_32(neon_remix_areas_32, vsubq_s32, generic_remix_areas_32_native, 1)
+
+#define NEON_MIX_FLOAT(name, op, scalar, remix)				\
+static void name(unsigned int size, volatile float *dst,		\
+		 float *src, volatile float *sum,			\
+		 size_t dst_step, size_t src_step, size_t sum_step)	\
+{									\
+	float *d = (float *)dst;					\
+	float *s = (float *)sum;					\
+									\
+	if (!simd_contiguous(dst_step, src_step, sum_step, 4)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4, src += 4, d += 4, s += 4) {	\
+		float32x4_t vsrc = vld1q_f32(src);			\
+		uint32x4_t mask = vceqq_f32(vld1q_f32(d), vdupq_n_f32(0.0f)); \
+		float32x4_t vsum = vbslq_f32(mask, vdupq_n_f32(0.0f), vld1q_f32(s)); \
+		vsum = op(vsum, vsrc);					\
+		vst1q_f32(s, vsum);					\
+		if (remix)						\
+			vsrc = vnegq_f32(vsrc);				\
+		vsum = vminq_f32(vmaxq_f32(vsum, vdupq_n_f32(-1.0f)),	\
+				 vdupq_n_f32(1.0f));			\
+		vst1q_f32(d, vbslq_f32(mask, vsrc, vsum));		\
+	}								\
+	if (size)							\
+		scalar(size, d, src, s, dst_step, src_step, sum_step);	\
+}
+
+NEON_MIX_FLOAT(neon_mix_areas_float, vaddq_f32, generic_mix_areas_float, 0)
+NEON_MIX_FLOAT(neon_remix_areas_float, vsubq_f32, generic_remix_areas_float, 1)
+
+#endif /* DMIX_SIMD_NEON */
+
+/*
+ * override the S16/S32/FLOAT callbacks with the vectorized versions if the CPU
+ * supports them; returns 1 if the callbacks were replaced
+ */
+static int simd_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	switch (dmix->shmptr->s.format) {
+	case SND_PCM_FORMAT_S16:
+	case SND_PCM_FORMAT_S32:
+	case SND_PCM_FORMAT_FLOAT:
+		break;
+	default:
+		return 0;
+	}
+#if defined(DMIX_SIMD_X86)
+	if (__builtin_cpu_supports("avx2")) {
+		dmix->u.dmix.mix_areas_16 = avx2_mix_areas_16;
+		dmix->u.dmix.remix_areas_16 = avx2_remix_areas_16;
+		dmix->u.dmix.mix_areas_32 = avx2_mix_areas_32;
+		dmix->u.dmix.remix_areas_32 = avx2_remix_areas_32;
+		dmix->u.dmix.mix_areas_float = avx2_mix_areas_float;
+		dmix->u.dmix.remix_areas_float = avx2_remix_areas_float;
+		return 1;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		dmix->u.dmix.mix_areas_16 = sse2_mix_areas_16;
+		dmix->u.dmix.remix_areas_16 = sse2_remix_areas_16;
+		dmix->u.dmix.mix_areas_32 = sse2_mix_areas_32;
+		dmix->u.dmix.remix_areas_32 = sse2_remix_areas_32;
+		dmix->u.dmix.mix_areas_float = sse2_mix_areas_float;
+		dmix->u.dmix.remix_areas_float = sse2_remix_areas_float;
+		return 1;
+	}
+#elif defined(DMIX_SIMD_NEON)
+	dmix->u.dmix.mix_areas_16 = neon_mix_areas_16;
+	dmix->u.dmix.remix_areas_16 = neon_remix_areas_16;
+	dmix->u.dmix.mix_areas_32 = neon_mix_areas_32;
+	dmix->u.dmix.remix_areas_32 = neon_remix_areas_32;
+	dmix->u.dmix.mix_areas_float = neon_mix_areas_float;
+	dmix->u.dmix.remix_areas_float = neon_remix_areas_float;
+	return 1;
+#endif
+	return 0;
+}
@@ -72,9 +72,18 @@ static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 	
 	if (!((1ULL<< dmix->shmptr->s.format) & x86_64_dmix_supported_format)) {
 		generic_mix_select_callbacks(dmix);
+		if (dmix->u.dmix.use_sem)
+			simd_mix_select_callbacks(dmix);
 		return;
 	}
 
+	/* the mixing is serialized by the client semaphore, so the
+	 * vectorized non-atomic code is preferred when available
+	 */
+	dmix->u.dmix.use_sem = !dmix->shmptr->u.dmix.lockless;
+	if (dmix->u.dmix.use_sem && simd_mix_select_callbacks(dmix))
+		return;
+
 	if (!smp) {
 		FILE *in;
 		char line[255];
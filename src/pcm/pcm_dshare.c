@@ -314,6 +314,7 @@ static int snd_pcm_dshare_start_timer(snd_pcm_direct_t *dshare)
 
 	snd_pcm_hwsync(dshare->spcm);
 	dshare->slave_appl_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
+	dshare->timer_period = (snd_pcm_uframes_t)-1;
 	err = snd_timer_start(dshare->timer);
 	if (err < 0)
 		return err;
@@ -515,7 +516,7 @@ static snd_pcm_sframes_t snd_pcm_dshare_mmap_commit(snd_pcm_t *pcm,
 		snd_pcm_dshare_sync_area(pcm);
 		/* clear timer queue to avoid a bogus return from poll */
 		if (snd_pcm_mmap_playback_avail(pcm) < pcm->avail_min)
-			snd_pcm_direct_clear_timer_queue(dshare);
+			snd_pcm_direct_check_timer_queue(dshare);
 	}
 	return size;
 }
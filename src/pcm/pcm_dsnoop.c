@@ -279,6 +279,7 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
+	dsnoop->timer_period = (snd_pcm_uframes_t)-1;
 	err = snd_timer_start(dsnoop->timer);
 	if (err < 0)
 		return err;
@@ -413,7 +414,7 @@ static snd_pcm_sframes_t snd_pcm_dsnoop_mmap_commit(snd_pcm_t *pcm,
 	snd_pcm_mmap_appl_forward(pcm, size);
 	/* clear timer queue to avoid a bogus return from poll */
 	if (snd_pcm_mmap_capture_avail(pcm) < pcm->avail_min)
-		snd_pcm_direct_clear_timer_queue(dsnoop);
+		snd_pcm_direct_check_timer_queue(dsnoop);
 	return size;
 }
 
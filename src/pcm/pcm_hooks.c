@@ -72,7 +72,7 @@ static int hook_add_dlobj(snd_pcm_t *pcm, void *dlobj)
 static void hook_remove_dlobj(struct snd_pcm_hook_dllist *dl)
 {
 	list_del(&dl->list);
-	snd_dlclose(dl->dlobj);
+	snd_dlobj_cache_put(dl->dlobj);
 	free(dl);
 }
 
@@ -347,7 +347,6 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 	snd_config_t *type = NULL, *args = NULL;
 	snd_config_iterator_t i, next;
 	int (*install_func)(snd_pcm_t *pcm, snd_config_t *args) = NULL;
-	void *h = NULL;
 
 	if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND) {
 		SNDERR("Invalid hook definition");
@@ -424,19 +423,9 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 		install = buf;
 		snprintf(buf, sizeof(buf), "_snd_pcm_hook_%s_install", str);
 	}
-	h = snd_dlopen(lib, RTLD_NOW);
-	install_func = h ? snd_dlsym(h, install, SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION)) : NULL;
-	err = 0;
-	if (!h) {
-		SNDERR("Cannot open shared library %s",
-		       lib ? lib : "[builtin]");
-		err = -ENOENT;
-	} else if (!install_func) {
-		SNDERR("symbol %s is not defined inside %s", install,
-		       lib ? lib : "[builtin]");
-		snd_dlclose(h);
-		err = -ENXIO;
-	}
+	install_func = snd_dlobj_cache_get(lib, install,
+			SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION), 1);
+	err = install_func ? 0 : -errno;
        _err:
 	if (type)
 		snd_config_delete(type);
@@ -454,11 +443,10 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 		err = install_func(pcm, args);
 
 	if (err >= 0)
-		err = hook_add_dlobj(pcm, h);
+		err = hook_add_dlobj(pcm, install_func);
 
 	if (err < 0) {
-		if(h)
-			snd_dlclose(h);
+		snd_dlobj_cache_put(install_func);
 		return err;
 	}
 	return 0;
@@ -32,6 +32,12 @@
 
 #include "plugin_ops.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifndef DOC_HIDDEN
 
 typedef float float_t;
@@ -56,6 +62,8 @@ typedef struct {
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
 		     unsigned int get32idx, unsigned int put32floatidx);
+	snd_pcm_linear_bulk_t bulk;
+	unsigned int bulk_src_width, bulk_dst_width;
 } snd_pcm_lfloat_t;
 
 int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
@@ -183,6 +191,258 @@ void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_area
 	}
 }
 
+/*
+ * bulk conversion of contiguous samples
+ *
+ * The most common conversions between native endian S16/S32 and
+ * FLOAT/FLOAT64 are done here with plain loops over packed buffers,
+ * vectorized where possible.  The results are identical to the label
+ * code above, including the clipping of out-of-range float samples.
+ */
+
+static inline int32_t lfloat_float_to_s32(float_t f)
+{
+	if (f >= 1.0)
+		return 0x7fffffff;
+	if (f <= -1.0)
+		return 0x80000000;
+	return (int32_t)(f * (float_t)0x80000000UL);
+}
+
+static inline int32_t lfloat_double_to_s32(double_t d)
+{
+	if (d >= 1.0)
+		return 0x7fffffff;
+	if (d <= -1.0)
+		return 0x80000000;
+	return (int32_t)(d * (double_t)0x80000000UL);
+}
+
+#if defined(__SSE2__)
+
+/* scale S32 to float and back; cvttps returns 0x80000000 for overflows,
+ * thus the positive ones are flipped to 0x7fffffff with the compare mask
+ */
+#define LFLOAT_SSE2_TO_FLOAT(v) \
+	_mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / (float_t)0x80000000UL))
+#define LFLOAT_SSE2_FROM_FLOAT(f) \
+	_mm_xor_si128(_mm_cvttps_epi32(_mm_mul_ps(f, _mm_set1_ps((float_t)0x80000000UL))), \
+		      _mm_castps_si128(_mm_cmpge_ps(f, _mm_set1_ps(1.0f))))
+
+static void lfloat_bulk_16_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int16_t *s = src;
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)s);
+		_mm_storeu_ps(d, LFLOAT_SSE2_TO_FLOAT(_mm_unpacklo_epi16(zero, v)));
+		_mm_storeu_ps(d + 4, LFLOAT_SSE2_TO_FLOAT(_mm_unpackhi_epi16(zero, v)));
+	}
+	while (samples-- > 0)
+		*d++ = (float_t)((int32_t)((u_int32_t)*s++ << 16)) / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_32_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		_mm_storeu_ps(d, LFLOAT_SSE2_TO_FLOAT(_mm_loadu_si128((const __m128i *)s)));
+	while (samples-- > 0)
+		*d++ = (float_t)*s++ / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_float_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const float_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		__m128i lo = LFLOAT_SSE2_FROM_FLOAT(_mm_loadu_ps(s));
+		__m128i hi = LFLOAT_SSE2_FROM_FLOAT(_mm_loadu_ps(s + 4));
+		_mm_storeu_si128((__m128i *)d,
+				 _mm_packs_epi32(_mm_srai_epi32(lo, 16),
+						 _mm_srai_epi32(hi, 16)));
+	}
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++) >> 16;
+}
+
+static void lfloat_bulk_float_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const float_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		_mm_storeu_si128((__m128i *)d, LFLOAT_SSE2_FROM_FLOAT(_mm_loadu_ps(s)));
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+/* vcvtq_s32_f32 truncates and saturates just like the clipping above */
+#define LFLOAT_NEON_TO_FLOAT(v) \
+	vmulq_n_f32(vcvtq_f32_s32(v), 1.0f / (float_t)0x80000000UL)
+#define LFLOAT_NEON_FROM_FLOAT(f) \
+	vcvtq_s32_f32(vmulq_n_f32(f, (float_t)0x80000000UL))
+
+static void lfloat_bulk_16_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int16_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		int16x8_t v = vld1q_s16(s);
+		vst1q_f32(d, LFLOAT_NEON_TO_FLOAT(vshll_n_s16(vget_low_s16(v), 16)));
+		vst1q_f32(d + 4, LFLOAT_NEON_TO_FLOAT(vshll_n_s16(vget_high_s16(v), 16)));
+	}
+	while (samples-- > 0)
+		*d++ = (float_t)((int32_t)((u_int32_t)*s++ << 16)) / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_32_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		vst1q_f32(d, LFLOAT_NEON_TO_FLOAT(vld1q_s32(s)));
+	while (samples-- > 0)
+		*d++ = (float_t)*s++ / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_float_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const float_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		int32x4_t lo = LFLOAT_NEON_FROM_FLOAT(vld1q_f32(s));
+		int32x4_t hi = LFLOAT_NEON_FROM_FLOAT(vld1q_f32(s + 4));
+		vst1q_s16(d, vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16)));
+	}
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++) >> 16;
+}
+
+static void lfloat_bulk_float_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const float_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		vst1q_s32(d, LFLOAT_NEON_FROM_FLOAT(vld1q_f32(s)));
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++);
+}
+
+#else
+
+static void lfloat_bulk_16_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int16_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (float_t)((int32_t)((u_int32_t)*s++ << 16)) / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_32_float(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	float_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (float_t)*s++ / (float_t)0x80000000UL;
+}
+
+static void lfloat_bulk_float_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const float_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++) >> 16;
+}
+
+static void lfloat_bulk_float_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const float_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = lfloat_float_to_s32(*s++);
+}
+
+#endif
+
+static void lfloat_bulk_16_float64(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	double_t *d = dst;
+	const int16_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (double_t)((int32_t)((u_int32_t)*s++ << 16)) / (double_t)0x80000000UL;
+}
+
+static void lfloat_bulk_32_float64(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	double_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (double_t)*s++ / (double_t)0x80000000UL;
+}
+
+static void lfloat_bulk_float64_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const double_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = lfloat_double_to_s32(*s++) >> 16;
+}
+
+static void lfloat_bulk_float64_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const double_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = lfloat_double_to_s32(*s++);
+}
+
+static const struct {
+	snd_pcm_format_t src, dst;
+	snd_pcm_linear_bulk_t func;
+} lfloat_bulk_funcs[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT, lfloat_bulk_16_float },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT, lfloat_bulk_32_float },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, lfloat_bulk_float_16 },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S32, lfloat_bulk_float_32 },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT64, lfloat_bulk_16_float64 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT64, lfloat_bulk_32_float64 },
+	{ SND_PCM_FORMAT_FLOAT64, SND_PCM_FORMAT_S16, lfloat_bulk_float64_16 },
+	{ SND_PCM_FORMAT_FLOAT64, SND_PCM_FORMAT_S32, lfloat_bulk_float64_32 },
+};
+
+static snd_pcm_linear_bulk_t snd_pcm_lfloat_bulk_func(snd_pcm_format_t src_format,
+						      snd_pcm_format_t dst_format)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(lfloat_bulk_funcs) / sizeof(lfloat_bulk_funcs[0]); i++) {
+		if (lfloat_bulk_funcs[i].src == src_format &&
+		    lfloat_bulk_funcs[i].dst == dst_format)
+			return lfloat_bulk_funcs[i].func;
+	}
+	return NULL;
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_lfloat_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
@@ -294,9 +554,33 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->bulk = snd_pcm_lfloat_bulk_func(src_format, dst_format);
+	lfloat->bulk_src_width = snd_pcm_format_physical_width(src_format);
+	lfloat->bulk_dst_width = snd_pcm_format_physical_width(dst_format);
 	return 0;
 }
 
+static void snd_pcm_lfloat_do_convert(snd_pcm_lfloat_t *lfloat,
+				      const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int channels,
+				      snd_pcm_uframes_t frames)
+{
+	if (lfloat->bulk &&
+	    snd_pcm_linear_bulk_convert(lfloat->bulk, dst_areas, dst_offset,
+					src_areas, src_offset,
+					channels, frames,
+					lfloat->bulk_src_width,
+					lfloat->bulk_dst_width))
+		return;
+	lfloat->func(dst_areas, dst_offset,
+		     src_areas, src_offset,
+		     channels, frames,
+		     lfloat->int32_idx, lfloat->float32_idx);
+}
+
 static snd_pcm_uframes_t
 snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -309,10 +593,8 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	snd_pcm_lfloat_do_convert(lfloat, slave_areas, slave_offset,
+				  areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +611,8 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	snd_pcm_lfloat_do_convert(lfloat, areas, offset,
+				  slave_areas, slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -399,6 +679,7 @@ int snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sfo
 	lfloat->plug.write = snd_pcm_lfloat_write_areas;
 	lfloat->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	lfloat->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	lfloat->plug.fuse = 1;
 	lfloat->plug.gen.slave = slave;
 	lfloat->plug.gen.close_slave = close_slave;
 
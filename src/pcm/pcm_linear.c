@@ -32,6 +32,12 @@
 
 #include "plugin_ops.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_linear = "";
@@ -44,6 +50,8 @@ typedef struct {
 	unsigned int use_getput;
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
+	snd_pcm_linear_bulk_t bulk;
+	unsigned int bulk_src_width, bulk_dst_width;
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
@@ -208,6 +216,305 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 	}
 }
 
+/*
+ * bulk conversion of contiguous samples
+ *
+ * The per-sample label dispatch above handles any area layout.  The most
+ * common conversions between the native endian formats are done here with
+ * plain loops (vectorized where possible) over a packed buffer instead.
+ */
+
+#if defined(__SSE2__)
+
+static void linear_bulk_16_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int16_t *s = src;
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)s);
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(zero, v));
+		_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(zero, v));
+	}
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 16;
+}
+
+static void linear_bulk_32_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		__m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(s + 4)), 16);
+		_mm_storeu_si128((__m128i *)d, _mm_packs_epi32(lo, hi));
+	}
+	while (samples-- > 0)
+		*d++ = *s++ >> 16;
+}
+
+static void linear_bulk_24_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		_mm_storeu_si128((__m128i *)d,
+				 _mm_slli_epi32(_mm_loadu_si128((const __m128i *)s), 8));
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 8;
+}
+
+static void linear_bulk_32_24(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		_mm_storeu_si128((__m128i *)d,
+				 _mm_srai_epi32(_mm_loadu_si128((const __m128i *)s), 8));
+	while (samples-- > 0)
+		*d++ = *s++ >> 8;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static void linear_bulk_16_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int16_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		int16x8_t v = vld1q_s16(s);
+		vst1q_s32(d, vshll_n_s16(vget_low_s16(v), 16));
+		vst1q_s32(d + 4, vshll_n_s16(vget_high_s16(v), 16));
+	}
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 16;
+}
+
+static void linear_bulk_32_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 8; samples -= 8, s += 8, d += 8)
+		vst1q_s16(d, vcombine_s16(vshrn_n_s32(vld1q_s32(s), 16),
+					  vshrn_n_s32(vld1q_s32(s + 4), 16)));
+	while (samples-- > 0)
+		*d++ = *s++ >> 16;
+}
+
+static void linear_bulk_24_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		vst1q_s32(d, vshlq_n_s32(vld1q_s32(s), 8));
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 8;
+}
+
+static void linear_bulk_32_24(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4)
+		vst1q_s32(d, vshrq_n_s32(vld1q_s32(s), 8));
+	while (samples-- > 0)
+		*d++ = *s++ >> 8;
+}
+
+#else
+
+static void linear_bulk_16_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int16_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 16;
+}
+
+static void linear_bulk_32_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = *s++ >> 16;
+}
+
+static void linear_bulk_24_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ << 8;
+}
+
+static void linear_bulk_32_24(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = *s++ >> 8;
+}
+
+#endif
+
+static void linear_bulk_16_24(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int32_t *d = dst;
+	const int16_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (int32_t)*s++ * 256;
+}
+
+static void linear_bulk_24_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	int16_t *d = dst;
+	const int32_t *s = src;
+
+	while (samples-- > 0)
+		*d++ = (u_int32_t)*s++ >> 8;
+}
+
+/* S24_3LE is handled byte-wise, so these work on both endians */
+static void linear_bulk_24_3le_32(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	u_int32_t *d = dst;
+	const u_int8_t *s = src;
+
+	for (; samples > 0; samples--, s += 3)
+		*d++ = (u_int32_t)s[0] << 8 | (u_int32_t)s[1] << 16 | (u_int32_t)s[2] << 24;
+}
+
+static void linear_bulk_32_24_3le(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	u_int8_t *d = dst;
+	const u_int32_t *s = src;
+
+	for (; samples > 0; samples--, d += 3) {
+		u_int32_t v = *s++;
+		d[0] = v >> 8;
+		d[1] = v >> 16;
+		d[2] = v >> 24;
+	}
+}
+
+static void linear_bulk_24_3le_16(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	u_int16_t *d = dst;
+	const u_int8_t *s = src;
+
+	for (; samples > 0; samples--, s += 3)
+		*d++ = s[1] | (u_int16_t)s[2] << 8;
+}
+
+static void linear_bulk_16_24_3le(void *dst, const void *src, snd_pcm_uframes_t samples)
+{
+	u_int8_t *d = dst;
+	const u_int16_t *s = src;
+
+	for (; samples > 0; samples--, d += 3) {
+		u_int16_t v = *s++;
+		d[0] = 0;
+		d[1] = v;
+		d[2] = v >> 8;
+	}
+}
+
+static const struct {
+	snd_pcm_format_t src;
+	snd_pcm_format_t dst;
+	snd_pcm_linear_bulk_t func;
+} linear_bulk_funcs[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32, linear_bulk_16_32 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S16, linear_bulk_32_16 },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S32, linear_bulk_24_32 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24, linear_bulk_32_24 },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24, linear_bulk_16_24 },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, linear_bulk_24_16 },
+	{ SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32, linear_bulk_24_3le_32 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24_3LE, linear_bulk_32_24_3le },
+	{ SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S16, linear_bulk_24_3le_16 },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24_3LE, linear_bulk_16_24_3le },
+};
+
+snd_pcm_linear_bulk_t snd_pcm_linear_bulk_func(snd_pcm_format_t src_format,
+					       snd_pcm_format_t dst_format)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(linear_bulk_funcs) / sizeof(linear_bulk_funcs[0]); i++) {
+		if (linear_bulk_funcs[i].src == src_format &&
+		    linear_bulk_funcs[i].dst == dst_format)
+			return linear_bulk_funcs[i].func;
+	}
+	return NULL;
+}
+
+/* do the areas describe one packed interleaved buffer? */
+static int linear_areas_packed(const snd_pcm_channel_area_t *areas,
+			       unsigned int channels, unsigned int width)
+{
+	unsigned int channel;
+
+	if (areas[0].step != channels * width || areas[0].first % 8)
+		return 0;
+	for (channel = 1; channel < channels; ++channel) {
+		if (areas[channel].addr != areas[0].addr ||
+		    areas[channel].step != areas[0].step ||
+		    areas[channel].first != areas[0].first + channel * width)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * convert with the given bulk function when all areas are contiguous,
+ * either as a packed interleaved buffer or as separate channel buffers;
+ * returns zero if the layout isn't suitable
+ */
+int snd_pcm_linear_bulk_convert(snd_pcm_linear_bulk_t func,
+				const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				unsigned int channels, snd_pcm_uframes_t frames,
+				unsigned int src_width, unsigned int dst_width)
+{
+	unsigned int channel;
+
+	if (!frames)
+		return 1;
+	if (linear_areas_packed(src_areas, channels, src_width) &&
+	    linear_areas_packed(dst_areas, channels, dst_width)) {
+		func(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		     snd_pcm_channel_area_addr(src_areas, src_offset),
+		     frames * channels);
+		return 1;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		if (src_areas[channel].step != src_width ||
+		    dst_areas[channel].step != dst_width ||
+		    src_areas[channel].first % 8 ||
+		    dst_areas[channel].first % 8)
+			return 0;
+	}
+	for (channel = 0; channel < channels; ++channel)
+		func(snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset),
+		     snd_pcm_channel_area_addr(&src_areas[channel], src_offset),
+		     frames);
+	return 1;
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_linear_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
@@ -302,6 +609,15 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	err = INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
 	if (err < 0)
 		return err;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		linear->bulk = snd_pcm_linear_bulk_func(format, linear->sformat);
+		linear->bulk_src_width = snd_pcm_format_physical_width(format);
+		linear->bulk_dst_width = snd_pcm_format_physical_width(linear->sformat);
+	} else {
+		linear->bulk = snd_pcm_linear_bulk_func(linear->sformat, format);
+		linear->bulk_src_width = snd_pcm_format_physical_width(linear->sformat);
+		linear->bulk_dst_width = snd_pcm_format_physical_width(format);
+	}
 	linear->use_getput = (snd_pcm_format_physical_width(format) == 24 ||
 			      snd_pcm_format_physical_width(linear->sformat) == 24);
 	if (linear->use_getput) {
@@ -323,6 +639,32 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	return 0;
 }
 
+static void snd_pcm_linear_do_convert(snd_pcm_linear_t *linear,
+				      const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int channels,
+				      snd_pcm_uframes_t frames)
+{
+	if (linear->bulk &&
+	    snd_pcm_linear_bulk_convert(linear->bulk, dst_areas, dst_offset,
+					src_areas, src_offset,
+					channels, frames,
+					linear->bulk_src_width,
+					linear->bulk_dst_width))
+		return;
+	if (linear->use_getput)
+		snd_pcm_linear_getput(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      channels, frames,
+				      linear->get_idx, linear->put_idx);
+	else
+		snd_pcm_linear_convert(dst_areas, dst_offset,
+				       src_areas, src_offset,
+				       channels, frames, linear->conv_idx);
+}
+
 static snd_pcm_uframes_t
 snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -335,15 +677,8 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(slave_areas, slave_offset,
-				      areas, offset, 
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(slave_areas, slave_offset,
-				       areas, offset, 
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_do_convert(linear, slave_areas, slave_offset,
+				  areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -360,15 +695,8 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(areas, offset, 
-				      slave_areas, slave_offset,
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(areas, offset, 
-				       slave_areas, slave_offset,
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_do_convert(linear, areas, offset,
+				  slave_areas, slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -435,6 +763,7 @@ int snd_pcm_linear_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sfo
 	linear->plug.write = snd_pcm_linear_write_areas;
 	linear->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	linear->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	linear->plug.fuse = 1;
 	linear->plug.gen.slave = slave;
 	linear->plug.gen.close_slave = close_slave;
 
@@ -239,6 +239,8 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	struct snd_pcm_refine_cache *refine_cache;	/* see snd_pcm_hw_refine_soft() */
+	snd_pcm_stats_t *stats;		/* transfer statistics, NULL if disabled */
 };
 
 /* make local functions really local */
@@ -302,6 +304,14 @@ struct _snd_pcm {
 	snd1_pcm_channel_info_shm
 #define snd_pcm_hw_refine_soft \
 	snd1_pcm_hw_refine_soft
+#define snd_pcm_hw_refine_cache_free \
+	snd1_pcm_hw_refine_cache_free
+#define snd_pcm_stats_enable \
+	snd1_pcm_stats_enable
+#define snd_pcm_stats_begin \
+	snd1_pcm_stats_begin
+#define snd_pcm_stats_end \
+	snd1_pcm_stats_end
 #define snd_pcm_hw_refine_slave \
 	snd1_pcm_hw_refine_slave
 #define snd_pcm_hw_params_slave \
@@ -531,24 +541,74 @@ static inline unsigned int snd_pcm_channel_area_step(const snd_pcm_channel_area_
 	return area->step / 8;
 }
 
+/*
+ * transfer statistics: a transfer through a PCM with statistics enabled
+ * is bracketed by snd_pcm_stats_begin() and snd_pcm_stats_end(); the
+ * time of the nested transfers of the slaves is subtracted from the
+ * self time of their master
+ */
+struct _snd_pcm_stats {
+	unsigned long long calls;	/* transfers through this PCM */
+	unsigned long long frames;	/* frames transferred */
+	unsigned long long total_ns;	/* including the slaves */
+	unsigned long long self_ns;	/* this PCM only */
+	unsigned long long max_ns;	/* longest transfer, including the slaves */
+	unsigned long long cpu_ns;	/* thread CPU time, including the slaves */
+};
+
+typedef struct {
+	unsigned long long start;
+	unsigned long long start_cpu;
+	unsigned long long child;	/* ns spent in nested transfers */
+	unsigned long long *outer;	/* child counter of the enclosing transfer */
+} snd_pcm_stats_frame_t;
+
+int snd_pcm_stats_enable(snd_pcm_t *pcm);
+void snd_pcm_stats_begin(snd_pcm_stats_frame_t *frame);
+void snd_pcm_stats_end(snd_pcm_t *pcm, snd_pcm_stats_frame_t *frame,
+		       snd_pcm_sframes_t frames);
+
+#define SND_PCM_STATS_CALL(pcm, result, call) do { \
+	snd_pcm_stats_frame_t __frame; \
+	if (!(pcm)->stats) { \
+		result = call; \
+		break; \
+	} \
+	snd_pcm_stats_begin(&__frame); \
+	result = call; \
+	snd_pcm_stats_end(pcm, &__frame, result); \
+} while (0)
+
 static inline snd_pcm_sframes_t _snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
-	return pcm->fast_ops->writei(pcm->fast_op_arg, buffer, size);
+	snd_pcm_sframes_t result;
+	SND_PCM_STATS_CALL(pcm, result,
+		pcm->fast_ops->writei(pcm->fast_op_arg, buffer, size));
+	return result;
 }
 
 static inline snd_pcm_sframes_t _snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
-	return pcm->fast_ops->writen(pcm->fast_op_arg, bufs, size);
+	snd_pcm_sframes_t result;
+	SND_PCM_STATS_CALL(pcm, result,
+		pcm->fast_ops->writen(pcm->fast_op_arg, bufs, size));
+	return result;
 }
 
 static inline snd_pcm_sframes_t _snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t size)
 {
-	return pcm->fast_ops->readi(pcm->fast_op_arg, buffer, size);
+	snd_pcm_sframes_t result;
+	SND_PCM_STATS_CALL(pcm, result,
+		pcm->fast_ops->readi(pcm->fast_op_arg, buffer, size));
+	return result;
 }
 
 static inline snd_pcm_sframes_t _snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
-	return pcm->fast_ops->readn(pcm->fast_op_arg, bufs, size);
+	snd_pcm_sframes_t result;
+	SND_PCM_STATS_CALL(pcm, result,
+		pcm->fast_ops->readn(pcm->fast_op_arg, bufs, size));
+	return result;
 }
 
 static inline int muldiv(int a, int b, int c, int *r)
@@ -592,6 +652,7 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 #undef _snd_pcm_hw_params
 int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+void snd_pcm_hw_refine_cache_free(snd_pcm_t *pcm);
 int snd_pcm_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			    int (*cprepare)(snd_pcm_t *pcm,
 					    snd_pcm_hw_params_t *params),
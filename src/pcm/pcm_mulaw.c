@@ -454,6 +454,7 @@ int snd_pcm_mulaw_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sfor
 	mulaw->plug.write = snd_pcm_mulaw_write_areas;
 	mulaw->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	mulaw->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	mulaw->plug.fuse = 1;
 	mulaw->plug.gen.slave = slave;
 	mulaw->plug.gen.close_slave = close_slave;
 
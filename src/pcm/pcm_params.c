@@ -2004,7 +2004,7 @@ static const snd_interval_t refine_intervals[SND_PCM_HW_PARAM_LAST_INTERVAL - SN
 #define RULES_DEBUG
 #endif
 
-int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
+static int snd_pcm_hw_refine_rules(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	unsigned int k;
 	snd_interval_t *i;
@@ -2112,6 +2112,94 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 	return changed;
 }
 
+/*
+ * The result of the rules depends only on the masks, the intervals and
+ * the few fields below of the input, so the last refinements done on a
+ * PCM are remembered and replayed; the plugin layers refine the same
+ * configuration space many times while a stream is being set up.
+ */
+#define REFINE_CACHE_SIZE	4
+
+struct snd_pcm_refine_entry {
+	snd_pcm_hw_params_t in;
+	snd_pcm_hw_params_t out;
+	unsigned int cmask;		/* parameters changed by the rules */
+};
+
+struct snd_pcm_refine_cache {
+	unsigned int count;
+	unsigned int next;		/* entry to be replaced */
+	struct snd_pcm_refine_entry entries[REFINE_CACHE_SIZE];
+};
+
+/* masks and intervals, including the reserved ones */
+#define REFINE_KEY_OFFSET	offsetof(snd_pcm_hw_params_t, masks)
+#define REFINE_KEY_SIZE		(offsetof(snd_pcm_hw_params_t, rmask) - REFINE_KEY_OFFSET)
+
+static int refine_key_equal(const snd_pcm_hw_params_t *a,
+			    const snd_pcm_hw_params_t *b)
+{
+	return a->rmask == b->rmask && a->msbits == b->msbits &&
+	       a->rate_num == b->rate_num && a->rate_den == b->rate_den &&
+	       !memcmp((const char *)a + REFINE_KEY_OFFSET,
+		       (const char *)b + REFINE_KEY_OFFSET, REFINE_KEY_SIZE);
+}
+
+static void refine_apply(snd_pcm_hw_params_t *params,
+			 const struct snd_pcm_refine_entry *e)
+{
+	memcpy((char *)params + REFINE_KEY_OFFSET,
+	       (const char *)&e->out + REFINE_KEY_OFFSET, REFINE_KEY_SIZE);
+	params->msbits = e->out.msbits;
+	params->rate_num = e->out.rate_num;
+	params->rate_den = e->out.rate_den;
+	params->cmask |= e->cmask;
+	params->rmask = 0;
+}
+
+int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	struct snd_pcm_refine_cache *cache = pcm->refine_cache;
+	struct snd_pcm_refine_entry *e = NULL;
+	unsigned int k, cmask;
+	int err;
+
+	if (cache) {
+		for (k = 0; k < cache->count; k++) {
+			e = &cache->entries[k];
+			if (refine_key_equal(params, &e->in)) {
+				refine_apply(params, e);
+				return 0;
+			}
+		}
+	} else {
+		cache = calloc(1, sizeof(*cache));
+		pcm->refine_cache = cache;
+	}
+	if (cache) {
+		e = &cache->entries[cache->next];
+		e->in = *params;
+	}
+	cmask = params->cmask;
+	params->cmask = 0;
+	err = snd_pcm_hw_refine_rules(pcm, params);
+	if (cache && err >= 0) {
+		e->out = *params;
+		e->cmask = params->cmask;
+		if (cache->count < REFINE_CACHE_SIZE)
+			cache->count++;
+		cache->next = (cache->next + 1) % REFINE_CACHE_SIZE;
+	}
+	params->cmask |= cmask;
+	return err;
+}
+
+void snd_pcm_hw_refine_cache_free(snd_pcm_t *pcm)
+{
+	free(pcm->refine_cache);
+	pcm->refine_cache = NULL;
+}
+
 int _snd_pcm_hw_params_refine(snd_pcm_hw_params_t *params,
 			      unsigned int vars,
 			      const snd_pcm_hw_params_t *src)
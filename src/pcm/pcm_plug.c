@@ -660,6 +660,8 @@ static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
 			return err;
 		}
 		if (err) {
+			if (pcm->stats)
+				snd_pcm_stats_enable(new);
 			plug->gen.slave = new;
 		}
 		k++;
@@ -251,6 +251,145 @@ snd_pcm_sframes_t snd_pcm_plugin_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frame
 	return (snd_pcm_sframes_t) frames;
 }
 
+/*
+ * Fused playback pass
+ *
+ * When a plugin and one or more of its slaves are sample-wise converters
+ * (the fuse flag), each block is passed through the whole chain at once
+ * using a small scratch buffer which stays in the cache.  The buffers
+ * of the intermediate plugins are never touched, only their application
+ * pointers are moved as if the data were written and committed there.
+ */
+
+#define PLUGIN_FUSE_BYTES	8192
+#define PLUGIN_FUSE_MAX		8
+
+static snd_pcm_t *snd_pcm_plugin_fuse_next(snd_pcm_t *pcm)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_t *slave = plugin->gen.slave;
+
+	if (!plugin->fuse || slave->fast_ops != &snd_pcm_plugin_fast_ops)
+		return NULL;
+	if (!((snd_pcm_plugin_t *)slave->private_data)->fuse)
+		return NULL;
+	return slave;
+}
+
+/*
+ * the members after the first one are not entered through their
+ * transfer functions, so their statistics are collected here
+ */
+static snd_pcm_uframes_t snd_pcm_plugin_fused_member(snd_pcm_t *pcm, int first,
+						     const snd_pcm_channel_area_t *areas,
+						     snd_pcm_uframes_t offset,
+						     snd_pcm_uframes_t size,
+						     const snd_pcm_channel_area_t *slave_areas,
+						     snd_pcm_uframes_t slave_offset,
+						     snd_pcm_uframes_t *slave_sizep)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_uframes_t frames;
+
+	if (first)
+		return plugin->write(pcm, areas, offset, size,
+				     slave_areas, slave_offset, slave_sizep);
+	SND_PCM_STATS_CALL(pcm, frames,
+		plugin->write(pcm, areas, offset, size,
+			      slave_areas, slave_offset, slave_sizep));
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_plugin_fused_write(snd_pcm_t *pcm,
+						    const snd_pcm_channel_area_t *areas,
+						    snd_pcm_uframes_t offset,
+						    snd_pcm_uframes_t size)
+{
+	snd_pcm_t *chain[PLUGIN_FUSE_MAX + 1];
+	snd_pcm_t *slave, *next;
+	unsigned int n, i, channels = 0, frame_bits = 0;
+	long long scratch[2][PLUGIN_FUSE_BYTES / sizeof(long long)];
+	snd_pcm_uframes_t block, xfer = 0;
+	int err;
+
+	chain[0] = pcm;
+	for (n = 0; n < PLUGIN_FUSE_MAX; n++) {
+		next = snd_pcm_plugin_fuse_next(chain[n]);
+		if (!next)
+			break;
+		chain[n + 1] = next;
+		if (next->channels > channels)
+			channels = next->channels;
+		if (next->frame_bits > frame_bits)
+			frame_bits = next->frame_bits;
+	}
+	slave = ((snd_pcm_plugin_t *)chain[n]->private_data)->gen.slave;
+	block = PLUGIN_FUSE_BYTES * 8 / frame_bits;
+	{
+		snd_pcm_channel_area_t scratch_areas[2][channels];
+
+		while (size > 0) {
+			const snd_pcm_channel_area_t *slave_areas, *src;
+			snd_pcm_uframes_t slave_offset, src_offset;
+			snd_pcm_uframes_t frames, slave_frames = ULONG_MAX;
+			snd_pcm_sframes_t result;
+
+			err = snd_pcm_mmap_begin(slave, &slave_areas, &slave_offset, &slave_frames);
+			if (err < 0 || slave_frames == 0)
+				break;
+			frames = size;
+			if (frames > block)
+				frames = block;
+			if (frames > slave_frames)
+				frames = slave_frames;
+			src = areas;
+			src_offset = offset;
+			for (i = 0; i < n; i++) {
+				snd_pcm_uframes_t cnt = frames;
+
+				snd_pcm_areas_from_buf(chain[i + 1], scratch_areas[i & 1],
+						       scratch[i & 1]);
+				frames = snd_pcm_plugin_fused_member(chain[i], i == 0,
+						src, src_offset, frames,
+						scratch_areas[i & 1], 0, &cnt);
+				src = scratch_areas[i & 1];
+				src_offset = 0;
+			}
+			frames = snd_pcm_plugin_fused_member(chain[n], 0,
+					src, src_offset, frames,
+					slave_areas, slave_offset, &slave_frames);
+			if (CHECK_SANITY(slave_frames > snd_pcm_mmap_playback_avail(slave))) {
+				SNDMSG("write overflow %ld > %ld", slave_frames,
+				       snd_pcm_mmap_playback_avail(slave));
+				return -EPIPE;
+			}
+			for (i = 0; i <= n; i++) {
+				snd_pcm_plugin_t *plugin = chain[i]->private_data;
+				snd_atomic_write_begin(&plugin->watom);
+				snd_pcm_mmap_appl_forward(chain[i], frames);
+			}
+			result = snd_pcm_mmap_commit(slave, slave_offset, slave_frames);
+			if (result < (snd_pcm_sframes_t)slave_frames) {
+				/* step back over the frames the slave did not take */
+				snd_pcm_uframes_t taken = result > 0 ? result : 0;
+				for (i = 0; i <= n; i++)
+					snd_pcm_mmap_appl_backward(chain[i], frames - taken);
+				frames = taken;
+			}
+			for (i = 0; i <= n; i++) {
+				snd_pcm_plugin_t *plugin = chain[i]->private_data;
+				snd_atomic_write_end(&plugin->watom);
+			}
+			if (result <= 0)
+				return xfer > 0 ? (snd_pcm_sframes_t)xfer : result;
+			offset += frames;
+			xfer += frames;
+			size -= frames;
+		}
+	}
+	return (snd_pcm_sframes_t)xfer;
+}
+
 static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 						    const snd_pcm_channel_area_t *areas,
 						    snd_pcm_uframes_t offset,
@@ -262,6 +401,8 @@ static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 	snd_pcm_sframes_t result;
 	int err;
 
+	if (snd_pcm_plugin_fuse_next(pcm))
+		return snd_pcm_plugin_fused_write(pcm, areas, offset, size);
 	while (size > 0) {
 		snd_pcm_uframes_t frames = size;
 		const snd_pcm_channel_area_t *slave_areas;
@@ -406,6 +547,28 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 	areas = snd_pcm_mmap_areas(pcm);
 	appl_offset = snd_pcm_mmap_offset(pcm);
 	xfer = 0;
+	if (snd_pcm_plugin_fuse_next(pcm)) {
+		while (size > 0 && slave_size > 0) {
+			snd_pcm_uframes_t frames = size;
+			snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
+			snd_pcm_sframes_t result;
+
+			if (frames > cont)
+				frames = cont;
+			result = snd_pcm_plugin_fused_write(pcm, areas, appl_offset, frames);
+			if (result <= 0)
+				return xfer > 0 ? xfer : result;
+			xfer += result;
+			size -= result;
+			slave_size -= result;
+			appl_offset += result;
+			if (appl_offset >= pcm->buffer_size)
+				appl_offset -= pcm->buffer_size;
+			/* the rest goes through the unfused loop */
+			if ((snd_pcm_uframes_t)result != frames)
+				break;
+		}
+	}
 	while (size > 0 && slave_size > 0) {
 		snd_pcm_uframes_t frames = size;
 		snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
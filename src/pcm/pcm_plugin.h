@@ -47,6 +47,7 @@ typedef struct {
 	int (*init)(snd_pcm_t *pcm);
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
 	snd_atomic_write_t watom;
+	int fuse;	/* sample-wise write, may run inside a fused pass */
 } snd_pcm_plugin_t;	
 
 /* make local functions really local */
@@ -89,6 +90,8 @@ snd_pcm_sframes_t snd_pcm_plugin_undo_write_generic
 #define snd_pcm_linear_convert_index	snd1_pcm_linear_convert_index
 #define snd_pcm_linear_convert	snd1_pcm_linear_convert
 #define snd_pcm_linear_getput	snd1_pcm_linear_getput
+#define snd_pcm_linear_bulk_func	snd1_pcm_linear_bulk_func
+#define snd_pcm_linear_bulk_convert	snd1_pcm_linear_bulk_convert
 #define snd_pcm_alaw_decode	snd1_pcm_alaw_decode
 #define snd_pcm_alaw_encode	snd1_pcm_alaw_encode
 #define snd_pcm_mulaw_decode	snd1_pcm_mulaw_decode
@@ -108,6 +111,18 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 			   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 			   unsigned int channels, snd_pcm_uframes_t frames,
 			   unsigned int get_idx, unsigned int put_idx);
+
+/* convert the given count of contiguous samples */
+typedef void (*snd_pcm_linear_bulk_t)(void *dst, const void *src,
+				      snd_pcm_uframes_t samples);
+
+snd_pcm_linear_bulk_t snd_pcm_linear_bulk_func(snd_pcm_format_t src_format,
+					       snd_pcm_format_t dst_format);
+int snd_pcm_linear_bulk_convert(snd_pcm_linear_bulk_t func,
+				const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				unsigned int channels, snd_pcm_uframes_t frames,
+				unsigned int src_width, unsigned int dst_width);
 void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 			 snd_pcm_uframes_t dst_offset,
 			 const snd_pcm_channel_area_t *src_areas,
@@ -72,6 +72,8 @@ struct _snd_pcm_rate {
 	snd_htimestamp_t trigger_tstamp;
 	unsigned int plugin_version;
 	unsigned int rate_min, rate_max;
+	snd_pcm_format_mask_t in_formats;	/* formats passed to convert */
+	snd_pcm_format_mask_t out_formats;
 };
 
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
@@ -83,11 +85,20 @@ static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_
 	snd_pcm_rate_t *rate = pcm->private_data;
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
-	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	snd_pcm_format_mask_t format_mask;
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
 		return err;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		format_mask = rate->in_formats;
+		if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
+			snd_mask_intersect(&format_mask, &rate->out_formats);
+	} else {
+		format_mask = rate->out_formats;
+		if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
+			snd_mask_intersect(&format_mask, &rate->in_formats);
+	}
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_FORMAT,
 					 &format_mask);
 	if (err < 0)
@@ -504,6 +515,23 @@ static void convert_from_s16(snd_pcm_rate_t *rate, const int16_t *buf,
 	}
 }
 
+/* can the areas be passed to convert_s16 without the copy? */
+static int is_s16_interleaved(const snd_pcm_channel_area_t *areas,
+			      snd_pcm_format_t format, unsigned int channels)
+{
+	unsigned int c;
+
+	if (format != SND_PCM_FORMAT_S16)
+		return 0;
+	for (c = 0; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].first != c * 16 ||
+		    areas[c].step != channels * 16)
+			return 0;
+	}
+	return 1;
+}
+
 static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		       const snd_pcm_channel_area_t *src_areas,
@@ -514,15 +542,15 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 	if (rate->ops.convert_s16) {
 		const int16_t *src;
 		int16_t *dst;
-		if (! rate->src_buf)
-			src = src_areas->addr + src_offset * 2 * channels;
+		if (is_s16_interleaved(src_areas, rate->info.in.format, channels))
+			src = (const int16_t *)src_areas->addr + src_offset * channels;
 		else {
 			convert_to_s16(rate, rate->src_buf, src_areas, src_offset,
 				       src_frames, channels);
 			src = rate->src_buf;
 		}
-		if (! rate->dst_buf)
-			dst = dst_areas->addr + dst_offset * 2 * channels;
+		if (is_s16_interleaved(dst_areas, rate->info.out.format, channels))
+			dst = (int16_t *)dst_areas->addr + dst_offset * channels;
 		else
 			dst = rate->dst_buf;
 		rate->ops.convert_s16(rate->obj, dst, dst_frames, src, src_frames);
@@ -1211,12 +1239,26 @@ const snd_config_t *snd_pcm_rate_get_default_converter(snd_config_t *root)
 	return NULL;
 }
 
-#ifdef PIC
+static const char *const builtin_rate_plugins[] = {
+	"linear",
+#ifndef HAVE_SOFT_FLOAT
+	"sinc_fast", "sinc", "sinc_best",
+#endif
+	NULL
+};
+
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	const char *const *types;
+
+	for (types = builtin_rate_plugins; *types; types++)
+		if (strcmp(type, *types) == 0)
+			return 1;
+	return 0;
 }
 
+#ifdef PIC
+
 static const char *const default_rate_plugins[] = {
 	"speexrate", "linear", NULL
 };
@@ -1264,6 +1306,39 @@ static int rate_open_func(snd_pcm_rate_t *rate, const char *type, int verbose)
 }
 #endif
 
+/*
+ * set up the formats passed to the converter; the linear formats are
+ * converted to S16 for convert_s16, and the convert callback handles all
+ * of them unless it reports its own list
+ */
+static int rate_get_supported_formats(snd_pcm_rate_t *rate)
+{
+	const snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+	u_int64_t in_formats, out_formats;
+	int err, f;
+
+	rate->in_formats = linear;
+	rate->out_formats = linear;
+	if (rate->ops.convert_s16 ||
+	    rate->plugin_version < 0x010003 || ! rate->ops.get_supported_formats)
+		return 0;
+	err = rate->ops.get_supported_formats(rate->obj, &in_formats,
+					      &out_formats);
+	if (err < 0)
+		return err;
+	snd_pcm_format_mask_none(&rate->in_formats);
+	snd_pcm_format_mask_none(&rate->out_formats);
+	for (f = 0; f <= SND_PCM_FORMAT_LAST && f < 64; f++) {
+		if (snd_pcm_format_linear(f) != 1 && ! snd_pcm_format_float(f))
+			continue;
+		if (in_formats & (1ULL << f))
+			snd_pcm_format_mask_set(&rate->in_formats, f);
+		if (out_formats & (1ULL << f))
+			snd_pcm_format_mask_set(&rate->out_formats, f);
+	}
+	return 0;
+}
+
 /**
  * \brief Creates a new rate PCM
  * \param pcmp Returns created PCM handle
@@ -1290,11 +1365,17 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 #ifndef PIC
 	snd_pcm_rate_open_func_t open_func;
 	extern int SND_PCM_RATE_PLUGIN_ENTRY(linear) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+#ifndef HAVE_SOFT_FLOAT
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(sinc_fast) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(sinc) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(sinc_best) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+#endif
 #endif
 
 	assert(pcmp && slave);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1)
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    ! snd_pcm_format_float(sformat))
 		return -EINVAL;
 	rate = calloc(1, sizeof(snd_pcm_rate_t));
 	if (!rate) {
@@ -1348,14 +1429,26 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return -ENOENT;
 	}
 #else
-	type = "linear";
+	/* only the built-in converters are available for static linking */
+	if (!converter || snd_config_get_string(converter, &type) < 0 ||
+	    !is_builtin_plugin(type))
+		type = "linear";
 	open_func = SND_PCM_RATE_PLUGIN_ENTRY(linear);
+#ifndef HAVE_SOFT_FLOAT
+	if (strcmp(type, "sinc_fast") == 0)
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(sinc_fast);
+	else if (strcmp(type, "sinc") == 0)
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(sinc);
+	else if (strcmp(type, "sinc_best") == 0)
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(sinc_best);
+#endif
 	err = open_func(SND_PCM_RATE_PLUGIN_VERSION, &rate->obj, &rate->ops);
 	if (err < 0) {
 		snd_pcm_free(pcm);
 		free(rate);
 		return err;
 	}
+	rate->plugin_version = rate->ops.version;
 #endif
 
 	if (! rate->ops.init || ! (rate->ops.convert || rate->ops.convert_s16) ||
@@ -1366,6 +1459,25 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	}
 
+	err = rate_get_supported_formats(rate);
+	if (err >= 0 && sformat != SND_PCM_FORMAT_UNKNOWN &&
+	    ! snd_pcm_format_mask_test(slave->stream == SND_PCM_STREAM_PLAYBACK ?
+				       &rate->out_formats : &rate->in_formats,
+				       sformat)) {
+		SNDERR("Slave format %s is not supported by rate converter %s",
+		       snd_pcm_format_name(sformat), type);
+		err = -EINVAL;
+	}
+	if (err < 0) {
+		if (rate->ops.close)
+			rate->ops.close(rate->obj);
+		if (rate->open_func)
+			snd_dlobj_cache_put(rate->open_func);
+		snd_pcm_free(pcm);
+		free(rate);
+		return err;
+	}
+
 	pcm->ops = &snd_pcm_rate_ops;
 	pcm->fast_ops = &snd_pcm_rate_fast_ops;
 	pcm->private_data = rate;
@@ -1384,7 +1496,8 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 
 \section pcm_plugins_rate Plugin: Rate
 
-This plugin converts a stream rate. The input and output formats must be linear.
+This plugin converts a stream rate. The input and output formats must be linear,
+or float when the converter processes float samples (e.g. \c sinc).
 
 \code
 pcm.name {
@@ -1406,6 +1519,13 @@ pcm.name {
 }
 \endcode
 
+The built-in converters are \c linear (linear interpolation) and the
+polyphase windowed-sinc converters \c sinc_fast, \c sinc and \c sinc_best
+(16, 32 and 64 filter taps per phase, more when decimating).
+The sinc converters process the samples in float, so 24 and 32 bit
+streams keep their full resolution.  Other types are loaded from the
+external rate plugins (e.g. \c speexrate from alsa-plugins).
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
@@ -1469,9 +1589,10 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1) {
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    ! snd_pcm_format_float(sformat)) {
 	    	snd_config_delete(sconf);
-		SNDERR("slave format is not linear");
+		SNDERR("slave format is not linear or float");
 		return -EINVAL;
 	}
 	err = snd_pcm_open_slave(&spcm, root, sconf, stream, mode, conf);
@@ -0,0 +1,492 @@
+/*
+ *  Polyphase windowed-sinc rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+/*
+ * The conversion ratio L/M (output/input) is taken from the period sizes,
+ * so that one period in produces exactly one period out.  The prototype
+ * low-pass filter (Kaiser windowed sinc) is split into L phases of "taps"
+ * coefficients each, computed once at init.  When the table would exceed
+ * SINC_MAX_COEFS, fewer phases are computed and the output is linearly
+ * interpolated between the two nearest ones.
+ *
+ * The samples are converted to float and kept per channel together with
+ * the history of the last (taps - 1) input samples, so S32 and FLOAT
+ * streams are processed at full precision.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "bswap.h"
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+
+#include "plugin_ops.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#ifndef HAVE_SOFT_FLOAT
+
+#define SINC_MAX_COEFS	(1 << 16)
+#define SINC_MAX_TAPS	512
+
+static const struct sinc_quality {
+	const char *name;
+	unsigned int taps;	/* taps per phase without decimation */
+	double rolloff;		/* cutoff relative to the lower Nyquist */
+	double beta;		/* Kaiser window parameter */
+} sinc_qualities[] = {
+	{ "fast", 16, 0.85, 6.0 },
+	{ "medium", 32, 0.91, 8.0 },
+	{ "best", 64, 0.95, 10.0 },
+};
+
+struct rate_sinc {
+	const struct sinc_quality *quality;
+	unsigned int channels;
+	unsigned int get_idx;
+	unsigned int put_idx;
+	snd_pcm_format_t in_format;
+	snd_pcm_format_t out_format;
+	unsigned int L, M;		/* output / input ratio */
+	unsigned int taps;		/* coefficients per phase */
+	unsigned int phases;		/* phases in the table */
+	float *coefs;			/* (phases + 1) * taps, time reversed */
+	float *buf;			/* per channel: history + input */
+	unsigned int buf_frames;	/* input frames per channel in buf */
+	unsigned int pos;		/* next input index */
+	unsigned int frac;		/* next phase, 0 .. L - 1 */
+};
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->M, rate->L);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->L, rate->M);
+}
+
+#if defined(__SSE2__)
+
+static inline float sinc_dot(const float *x, const float *c, unsigned int taps)
+{
+	__m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+
+	for (; taps; taps -= 8, x += 8, c += 8) {
+		a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x), _mm_loadu_ps(c)));
+		a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + 4), _mm_loadu_ps(c + 4)));
+	}
+	a0 = _mm_add_ps(a0, a1);
+	a0 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
+	a0 = _mm_add_ss(a0, _mm_shuffle_ps(a0, a0, 1));
+	return _mm_cvtss_f32(a0);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static inline float sinc_dot(const float *x, const float *c, unsigned int taps)
+{
+	float32x4_t a0 = vdupq_n_f32(0), a1 = vdupq_n_f32(0);
+	float32x2_t s;
+
+	for (; taps; taps -= 8, x += 8, c += 8) {
+		a0 = vmlaq_f32(a0, vld1q_f32(x), vld1q_f32(c));
+		a1 = vmlaq_f32(a1, vld1q_f32(x + 4), vld1q_f32(c + 4));
+	}
+	a0 = vaddq_f32(a0, a1);
+	s = vadd_f32(vget_low_f32(a0), vget_high_f32(a0));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+#else
+
+static inline float sinc_dot(const float *x, const float *c, unsigned int taps)
+{
+	float a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+
+	for (; taps; taps -= 4, x += 4, c += 4) {
+		a0 += x[0] * c[0];
+		a1 += x[1] * c[1];
+		a2 += x[2] * c[2];
+		a3 += x[3] * c[3];
+	}
+	return (a0 + a1) + (a2 + a3);
+}
+
+#endif
+
+static void sinc_read(struct rate_sinc *rate, float *dst,
+		      const snd_pcm_channel_area_t *src_area,
+		      snd_pcm_uframes_t src_offset, unsigned int frames)
+{
+#define GET32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+	void *get = get32_labels[rate->get_idx];
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+	int32_t sample = 0;
+
+	switch (rate->in_format) {
+	case SND_PCM_FORMAT_FLOAT:
+		for (; frames--; src += src_step)
+			*dst++ = *(const float *)src;
+		return;
+	case SND_PCM_FORMAT_S16:
+		for (; frames--; src += src_step)
+			*dst++ = *(const int16_t *)src * (1.0f / 0x8000);
+		return;
+	case SND_PCM_FORMAT_S32:
+		for (; frames--; src += src_step)
+			*dst++ = *(const int32_t *)src * (1.0f / 0x80000000UL);
+		return;
+	default:
+		break;
+	}
+	while (frames--) {
+		goto *get;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+	after_get:
+		*dst++ = sample * (1.0f / 0x80000000UL);
+		src += src_step;
+	}
+}
+
+static inline int32_t sinc_to_s32(float f)
+{
+	if (f >= 1.0f)
+		return 0x7fffffff;
+	if (f <= -1.0f)
+		return 0x80000000;
+	return (int32_t)(f * (float)0x80000000UL);
+}
+
+static void sinc_write(struct rate_sinc *rate, char *dst, float val)
+{
+#define PUT32_LABELS
+#include "plugin_ops.h"
+#undef PUT32_LABELS
+	void *put = put32_labels[rate->put_idx];
+	int32_t sample;
+
+	switch (rate->out_format) {
+	case SND_PCM_FORMAT_FLOAT:
+		*(float *)dst = val;
+		return;
+	case SND_PCM_FORMAT_S16:
+		*(int16_t *)dst = sinc_to_s32(val) >> 16;
+		return;
+	case SND_PCM_FORMAT_S32:
+		*(int32_t *)dst = sinc_to_s32(val);
+		return;
+	default:
+		break;
+	}
+	sample = sinc_to_s32(val);
+	goto *put;
+#define PUT32_END after_put
+#include "plugin_ops.h"
+#undef PUT32_END
+ after_put:
+	return;
+}
+
+static void sinc_convert(void *obj,
+			 const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	struct rate_sinc *rate = obj;
+	unsigned int hist = rate->taps - 1;
+	unsigned int channel, pos = 0, frac = 0;
+
+	if (CHECK_SANITY(src_frames > rate->buf_frames)) {
+		SNDERR("src_frames overflow");
+		src_frames = rate->buf_frames;
+	}
+	if (! src_frames)
+		return;
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		float *buf = rate->buf + channel * (hist + rate->buf_frames);
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		unsigned int dst_frames1;
+
+		sinc_read(rate, buf + hist, &src_areas[channel], src_offset,
+			  src_frames);
+		pos = rate->pos;
+		frac = rate->frac;
+		for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+			unsigned int idx = pos < src_frames ? pos : src_frames - 1;
+			const float *c = rate->coefs;
+			float val;
+			if (rate->phases == rate->L) {
+				val = sinc_dot(buf + idx, c + frac * rate->taps,
+					       rate->taps);
+			} else {
+				u_int64_t t = (u_int64_t)frac * rate->phases;
+				unsigned int phase = t / rate->L;
+				float v0, v1;
+				c += phase * rate->taps;
+				v0 = sinc_dot(buf + idx, c, rate->taps);
+				v1 = sinc_dot(buf + idx, c + rate->taps, rate->taps);
+				val = v0 + (v1 - v0) * (float)(t % rate->L) / rate->L;
+			}
+			sinc_write(rate, dst, val);
+			dst += dst_step;
+			frac += rate->M;
+			pos += frac / rate->L;
+			frac %= rate->L;
+		}
+		memmove(buf, buf + src_frames, hist * sizeof(*buf));
+	}
+	rate->pos = pos > src_frames ? pos - src_frames : 0;
+	rate->frac = frac;
+}
+
+static double sinc_bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+	unsigned int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static void sinc_make_table(struct rate_sinc *rate)
+{
+	double cutoff, center = rate->taps / 2.0;
+	double beta = rate->quality->beta;
+	double i0beta = sinc_bessel_i0(beta);
+	unsigned int p, k;
+
+	cutoff = rate->quality->rolloff;
+	if (rate->M > rate->L)
+		cutoff = cutoff * rate->L / rate->M;
+	for (p = 0; p <= rate->phases; p++) {
+		float *c = rate->coefs + p * rate->taps;
+		double sum = 0;
+		for (k = 0; k < rate->taps; k++) {
+			/* time relative to the window center in input samples */
+			double t = (rate->taps - 1 - k) + (double)p / rate->phases - center;
+			double x = t / center, v;
+			if (x <= -1.0 || x >= 1.0)
+				v = 0;
+			else {
+				v = cutoff;
+				if (t != 0)
+					v = sin(M_PI * cutoff * t) / (M_PI * t);
+				v *= sinc_bessel_i0(beta * sqrt(1 - x * x)) / i0beta;
+			}
+			c[k] = v;
+			sum += v;
+		}
+		/* unity gain for each phase */
+		if (sum != 0)
+			for (k = 0; k < rate->taps; k++)
+				c[k] /= sum;
+	}
+}
+
+static void sinc_free(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	free(rate->coefs);
+	rate->coefs = NULL;
+	free(rate->buf);
+	rate->buf = NULL;
+}
+
+static unsigned int sinc_gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static int sinc_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_sinc *rate = obj;
+	unsigned int in = info->in.period_size, out = info->out.period_size;
+	unsigned int g, taps;
+
+	if (! in || ! out) {
+		in = info->in.rate;
+		out = info->out.rate;
+	}
+	g = sinc_gcd(in, out);
+	rate->L = out / g;
+	rate->M = in / g;
+	rate->channels = info->channels;
+	rate->in_format = info->in.format;
+	rate->out_format = info->out.format;
+	if (snd_pcm_format_linear(info->in.format))
+		rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S32);
+	if (snd_pcm_format_linear(info->out.format))
+		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, info->out.format);
+
+	/* widen the filter when decimating to keep the same transition band */
+	taps = rate->quality->taps;
+	if (rate->M > rate->L)
+		taps = ((u_int64_t)taps * rate->M + rate->L - 1) / rate->L;
+	taps = (taps + 7) & ~7;
+	if (taps > SINC_MAX_TAPS)
+		taps = SINC_MAX_TAPS;
+	rate->taps = taps;
+	rate->phases = SINC_MAX_COEFS / taps;
+	if (rate->L <= rate->phases)
+		rate->phases = rate->L;
+
+	sinc_free(rate);
+	rate->coefs = malloc(sizeof(*rate->coefs) * (rate->phases + 1) * rate->taps);
+	rate->buf_frames = info->in.period_size;
+	rate->buf = calloc(rate->channels * (rate->taps - 1 + rate->buf_frames),
+			   sizeof(*rate->buf));
+	if (! rate->coefs || ! rate->buf) {
+		sinc_free(rate);
+		return -ENOMEM;
+	}
+	sinc_make_table(rate);
+	rate->pos = 0;
+	rate->frac = 0;
+	return 0;
+}
+
+static void sinc_reset(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	if (rate->buf)
+		memset(rate->buf, 0, sizeof(*rate->buf) * rate->channels *
+		       (rate->taps - 1 + rate->buf_frames));
+	rate->pos = 0;
+	rate->frac = 0;
+}
+
+static void sinc_close(void *obj)
+{
+	sinc_free(obj);
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static void sinc_dump(void *obj, snd_output_t *out)
+{
+	struct rate_sinc *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase windowed-sinc (%s)\n",
+			  rate->quality->name);
+	if (rate->coefs)
+		snd_output_printf(out, "  ratio %u/%u, %u taps, %u phases\n",
+				  rate->L, rate->M, rate->taps, rate->phases);
+}
+
+static int sinc_get_supported_formats(ATTRIBUTE_UNUSED void *obj,
+				      u_int64_t *in_formats,
+				      u_int64_t *out_formats)
+{
+	int f;
+
+	/* all linear formats through get32/put32, float natively */
+	*in_formats = 1ULL << SND_PCM_FORMAT_FLOAT;
+	for (f = 0; f <= SND_PCM_FORMAT_LAST && f < 64; f++)
+		if (snd_pcm_format_linear(f) == 1)
+			*in_formats |= 1ULL << f;
+	*out_formats = *in_formats;
+	return 0;
+}
+
+static const snd_pcm_rate_ops_t sinc_ops = {
+	.close = sinc_close,
+	.init = sinc_init,
+	.free = sinc_free,
+	.reset = sinc_reset,
+	.convert = sinc_convert,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = sinc_dump,
+	.get_supported_formats = sinc_get_supported_formats,
+};
+
+static int sinc_open(unsigned int quality, void **objp, snd_pcm_rate_ops_t *ops)
+{
+	struct rate_sinc *rate;
+
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->quality = &sinc_qualities[quality];
+
+	*objp = rate;
+	*ops = sinc_ops;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc_fast) (ATTRIBUTE_UNUSED unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(0, objp, ops);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc) (ATTRIBUTE_UNUSED unsigned int version,
+				     void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(1, objp, ops);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc_best) (ATTRIBUTE_UNUSED unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(2, objp, ops);
+}
+
+#endif /* HAVE_SOFT_FLOAT */
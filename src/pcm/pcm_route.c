@@ -33,6 +33,12 @@
 
 #include "plugin_ops.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_route = "";
@@ -59,6 +65,18 @@ typedef struct {
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/* sources of one destination sharing the same gain */
+typedef struct {
+	float gain;
+	unsigned int nsrcs;
+	unsigned int *srcs;
+} snd_pcm_route_group_t;
+
+/* frames mixed at once by the precompiled program */
+#define ROUTE_MIX_BLOCK		256
+#endif
+
 typedef struct {
 	enum {UINT64, FLOAT} sum_idx;
 	unsigned int get_idx;
@@ -70,6 +88,14 @@ typedef struct {
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	int use_mix;		/* run the precompiled mixing program */
+	int mix_copy;		/* source and destination formats are equal */
+	snd_pcm_format_t src_sfmt;
+	unsigned int mix_nsrcs;	/* sources feeding mixed destinations */
+	unsigned int *mix_srcs;
+	float *mix_buf;		/* (nsrcs + 2) blocks of float samples */
+#endif
 } snd_pcm_route_params_t;
 
 
@@ -87,6 +113,10 @@ struct snd_pcm_route_ttable_dst {
 	unsigned int nsrcs;
 	snd_pcm_route_ttable_src_t* srcs;
 	route_f func;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	unsigned int ngroups;
+	snd_pcm_route_group_t *groups;
+#endif
 };
 
 typedef union {
@@ -395,6 +425,357 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+
+/*
+ * Precompiled mixing program
+ *
+ * The sources of the mixed destinations are converted once per block
+ * to float, each destination is then summed group by group (one multiply
+ * per distinct gain) and normalized like norm_float above.
+ */
+
+static void route_mix_norm(int32_t *dst, const float *src, unsigned int n)
+{
+	while (n-- > 0) {
+		float sum = rint(*src++);
+		if (sum > (int64_t)0x7fffffff)
+			*dst++ = 0x7fffffff;	/* maximum positive value */
+		else if (sum < -(int64_t)0x80000000)
+			*dst++ = 0x80000000;	/* maximum negative value */
+		else
+			*dst++ = sum;
+	}
+}
+
+#if defined(__SSE2__)
+
+static void route_mix_mul(float *acc, const float *in, float gain, unsigned int n)
+{
+	const __m128 g = _mm_set1_ps(gain);
+
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		_mm_storeu_ps(acc, _mm_mul_ps(_mm_loadu_ps(in), g));
+	while (n-- > 0)
+		*acc++ = *in++ * gain;
+}
+
+static void route_mix_mac(float *acc, const float *in, float gain, unsigned int n)
+{
+	const __m128 g = _mm_set1_ps(gain);
+
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc),
+					      _mm_mul_ps(_mm_loadu_ps(in), g)));
+	while (n-- > 0) {
+		*acc += *in++ * gain;
+		acc++;
+	}
+}
+
+static void route_mix_add(float *acc, const float *in, unsigned int n)
+{
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_loadu_ps(in)));
+	while (n-- > 0)
+		*acc++ += *in++;
+}
+
+static void route_mix_load_s16(float *dst, const int16_t *src, unsigned int n)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; n >= 8; n -= 8, src += 8, dst += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_ps(dst, _mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, v)));
+		_mm_storeu_ps(dst + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, v)));
+	}
+	while (n-- > 0)
+		*dst++ = (int32_t)((u_int32_t)*src++ << 16);
+}
+
+static void route_mix_load_s32(float *dst, const int32_t *src, unsigned int n)
+{
+	for (; n >= 4; n -= 4, src += 4, dst += 4)
+		_mm_storeu_ps(dst, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)src)));
+	while (n-- > 0)
+		*dst++ = *src++;
+}
+
+/* cvtps rounds like rint() and returns 0x80000000 for overflows,
+ * thus the positive ones are replaced with the compare mask
+ */
+static inline __m128i route_mix_norm4(__m128 v)
+{
+	const __m128i max = _mm_set1_epi32(0x7fffffff);
+	__m128i over = _mm_castps_si128(_mm_cmpgt_ps(v, _mm_set1_ps((float)0x7fffffff)));
+
+	return _mm_or_si128(_mm_and_si128(over, max),
+			    _mm_andnot_si128(over, _mm_cvtps_epi32(v)));
+}
+
+static void route_mix_store_s16(int16_t *dst, const float *src, unsigned int n)
+{
+	for (; n >= 8; n -= 8, src += 8, dst += 8) {
+		__m128i lo = route_mix_norm4(_mm_loadu_ps(src));
+		__m128i hi = route_mix_norm4(_mm_loadu_ps(src + 4));
+		_mm_storeu_si128((__m128i *)dst,
+				 _mm_packs_epi32(_mm_srai_epi32(lo, 16),
+						 _mm_srai_epi32(hi, 16)));
+	}
+	while (n-- > 0) {
+		int32_t sample;
+		route_mix_norm(&sample, src++, 1);
+		*dst++ = sample >> 16;
+	}
+}
+
+static void route_mix_store_s32(int32_t *dst, const float *src, unsigned int n)
+{
+	for (; n >= 4; n -= 4, src += 4, dst += 4)
+		_mm_storeu_si128((__m128i *)dst, route_mix_norm4(_mm_loadu_ps(src)));
+	route_mix_norm(dst, src, n);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static void route_mix_mul(float *acc, const float *in, float gain, unsigned int n)
+{
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		vst1q_f32(acc, vmulq_n_f32(vld1q_f32(in), gain));
+	while (n-- > 0)
+		*acc++ = *in++ * gain;
+}
+
+static void route_mix_mac(float *acc, const float *in, float gain, unsigned int n)
+{
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		vst1q_f32(acc, vaddq_f32(vld1q_f32(acc),
+					 vmulq_n_f32(vld1q_f32(in), gain)));
+	while (n-- > 0) {
+		*acc += *in++ * gain;
+		acc++;
+	}
+}
+
+static void route_mix_add(float *acc, const float *in, unsigned int n)
+{
+	for (; n >= 4; n -= 4, acc += 4, in += 4)
+		vst1q_f32(acc, vaddq_f32(vld1q_f32(acc), vld1q_f32(in)));
+	while (n-- > 0)
+		*acc++ += *in++;
+}
+
+static void route_mix_load_s16(float *dst, const int16_t *src, unsigned int n)
+{
+	for (; n >= 8; n -= 8, src += 8, dst += 8) {
+		int16x8_t v = vld1q_s16(src);
+		vst1q_f32(dst, vcvtq_f32_s32(vshll_n_s16(vget_low_s16(v), 16)));
+		vst1q_f32(dst + 4, vcvtq_f32_s32(vshll_n_s16(vget_high_s16(v), 16)));
+	}
+	while (n-- > 0)
+		*dst++ = (int32_t)((u_int32_t)*src++ << 16);
+}
+
+static void route_mix_load_s32(float *dst, const int32_t *src, unsigned int n)
+{
+	for (; n >= 4; n -= 4, src += 4, dst += 4)
+		vst1q_f32(dst, vcvtq_f32_s32(vld1q_s32(src)));
+	while (n-- > 0)
+		*dst++ = *src++;
+}
+
+#else
+
+static void route_mix_mul(float *acc, const float *in, float gain, unsigned int n)
+{
+	while (n-- > 0)
+		*acc++ = *in++ * gain;
+}
+
+static void route_mix_mac(float *acc, const float *in, float gain, unsigned int n)
+{
+	while (n-- > 0) {
+		*acc += *in++ * gain;
+		acc++;
+	}
+}
+
+static void route_mix_add(float *acc, const float *in, unsigned int n)
+{
+	while (n-- > 0)
+		*acc++ += *in++;
+}
+
+static void route_mix_load_s16(float *dst, const int16_t *src, unsigned int n)
+{
+	while (n-- > 0)
+		*dst++ = (int32_t)((u_int32_t)*src++ << 16);
+}
+
+static void route_mix_load_s32(float *dst, const int32_t *src, unsigned int n)
+{
+	while (n-- > 0)
+		*dst++ = *src++;
+}
+
+#endif
+
+#if !defined(__SSE2__)
+
+/* ARMv7 NEON has no rounding float to integer conversion */
+static void route_mix_store_s16(int16_t *dst, const float *src, unsigned int n)
+{
+	while (n-- > 0) {
+		int32_t sample;
+		route_mix_norm(&sample, src++, 1);
+		*dst++ = sample >> 16;
+	}
+}
+
+static void route_mix_store_s32(int32_t *dst, const float *src, unsigned int n)
+{
+	route_mix_norm(dst, src, n);
+}
+
+#endif
+
+static void route_mix_load(float *dst, const snd_pcm_channel_area_t *src_area,
+			   snd_pcm_uframes_t src_offset, unsigned int n,
+			   snd_pcm_format_t format)
+{
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+
+	if (format == SND_PCM_FORMAT_S16) {
+		if (src_step == 2) {
+			route_mix_load_s16(dst, (const int16_t *)src, n);
+			return;
+		}
+		for (; n > 0; n--, src += src_step)
+			route_mix_load_s16(dst++, (const int16_t *)src, 1);
+	} else {
+		if (src_step == 4) {
+			route_mix_load_s32(dst, (const int32_t *)src, n);
+			return;
+		}
+		for (; n > 0; n--, src += src_step)
+			route_mix_load_s32(dst++, (const int32_t *)src, 1);
+	}
+}
+
+static void route_mix_store(const snd_pcm_channel_area_t *dst_area,
+			    snd_pcm_uframes_t dst_offset,
+			    const float *src, unsigned int n,
+			    snd_pcm_format_t format)
+{
+	char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	int dst_step = snd_pcm_channel_area_step(dst_area);
+
+	if (format == SND_PCM_FORMAT_S16) {
+		if (dst_step == 2) {
+			route_mix_store_s16((int16_t *)dst, src, n);
+			return;
+		}
+		for (; n > 0; n--, dst += dst_step)
+			route_mix_store_s16((int16_t *)dst, src++, 1);
+	} else {
+		if (dst_step == 4) {
+			route_mix_store_s32((int32_t *)dst, src, n);
+			return;
+		}
+		for (; n > 0; n--, dst += dst_step)
+			route_mix_store_s32((int32_t *)dst, src++, 1);
+	}
+}
+
+static inline int route_mix_is_copy(const snd_pcm_route_ttable_dst_t *dstp)
+{
+	return dstp->nsrcs == 1 && !dstp->att;
+}
+
+static void snd_pcm_route_convert_mix(const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int src_channels,
+				      unsigned int dst_channels,
+				      snd_pcm_uframes_t frames,
+				      snd_pcm_route_params_t *params)
+{
+	unsigned int dst_channel, ndsts, nmix = 0;
+	snd_pcm_route_ttable_dst_t *dstp;
+	snd_pcm_uframes_t done;
+	float *acc, *tmp;
+
+	/* silence, copies and permutations need no mixing */
+	ndsts = dst_channels < params->ndsts ? dst_channels : params->ndsts;
+	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[dst_channel];
+		const snd_pcm_channel_area_t *src_area;
+		dstp = &params->dsts[dst_channel];
+		if (dst_channel >= ndsts || dstp->nsrcs == 0) {
+			snd_pcm_area_silence(dst_area, dst_offset, frames,
+					     params->dst_sfmt);
+		} else if (route_mix_is_copy(dstp)) {
+			src_area = &src_areas[dstp->srcs[0].channel];
+			if (params->mix_copy && src_area->addr)
+				snd_pcm_area_copy(dst_area, dst_offset,
+						  src_area, src_offset,
+						  frames, params->dst_sfmt);
+			else
+				snd_pcm_route_convert1_one(dst_area, dst_offset,
+							   src_areas, src_offset,
+							   src_channels,
+							   frames, dstp, params);
+		} else
+			nmix++;
+	}
+	if (!nmix)
+		return;
+
+	acc = params->mix_buf + params->nsrcs * ROUTE_MIX_BLOCK;
+	tmp = acc + ROUTE_MIX_BLOCK;
+	for (done = 0; done < frames; ) {
+		unsigned int n = ROUTE_MIX_BLOCK, i;
+		if (n > frames - done)
+			n = frames - done;
+		for (i = 0; i < params->mix_nsrcs; i++) {
+			unsigned int channel = params->mix_srcs[i];
+			route_mix_load(params->mix_buf + channel * ROUTE_MIX_BLOCK,
+				       &src_areas[channel], src_offset + done, n,
+				       params->src_sfmt);
+		}
+		for (dst_channel = 0; dst_channel < ndsts; ++dst_channel) {
+			const snd_pcm_route_group_t *grp;
+			dstp = &params->dsts[dst_channel];
+			if (dstp->nsrcs == 0 || route_mix_is_copy(dstp))
+				continue;
+			for (grp = dstp->groups; grp < dstp->groups + dstp->ngroups; grp++) {
+				const float *in = params->mix_buf + grp->srcs[0] * ROUTE_MIX_BLOCK;
+				if (grp->nsrcs > 1) {
+					unsigned int j;
+					memcpy(tmp, in, n * sizeof(*tmp));
+					for (j = 1; j < grp->nsrcs; j++)
+						route_mix_add(tmp, params->mix_buf + grp->srcs[j] * ROUTE_MIX_BLOCK, n);
+					in = tmp;
+				}
+				if (grp == dstp->groups)
+					route_mix_mul(acc, in, grp->gain, n);
+				else if (grp->gain == 1.0f)
+					route_mix_add(acc, in, n);
+				else
+					route_mix_mac(acc, in, grp->gain, n);
+			}
+			route_mix_store(&dst_areas[dst_channel], dst_offset + done,
+					acc, n, params->dst_sfmt);
+		}
+		done += n;
+	}
+}
+
+#endif /* SND_PCM_PLUGIN_ROUTE_FLOAT */
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -410,6 +791,15 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	if (params->use_mix && src_channels >= params->nsrcs) {
+		snd_pcm_route_convert_mix(dst_areas, dst_offset,
+					  src_areas, src_offset,
+					  src_channels, dst_channels,
+					  frames, params);
+		return;
+	}
+#endif
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -437,9 +827,16 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 	if (params->dsts) {
 		for (dst_channel = 0; dst_channel < params->ndsts; ++dst_channel) {
 			free(params->dsts[dst_channel].srcs);
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+			free(params->dsts[dst_channel].groups);
+#endif
 		}
 		free(params->dsts);
 	}
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	free(params->mix_srcs);
+	free(params->mix_buf);
+#endif
 	free(route->chmap);
 	return snd_pcm_generic_close(pcm);
 }
@@ -576,6 +973,18 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	route->params.dst_sfmt = dst_format;
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
 	route->params.sum_idx = FLOAT;
+	route->params.src_sfmt = src_format;
+	route->params.mix_copy = src_format == dst_format;
+	route->params.use_mix =
+		(src_format == SND_PCM_FORMAT_S16 || src_format == SND_PCM_FORMAT_S32) &&
+		(dst_format == SND_PCM_FORMAT_S16 || dst_format == SND_PCM_FORMAT_S32);
+	if (route->params.use_mix && !route->params.mix_buf) {
+		route->params.mix_buf = malloc((route->params.nsrcs + 2) *
+					       ROUTE_MIX_BLOCK * sizeof(float));
+		/* the per-sample path still works without it */
+		if (!route->params.mix_buf)
+			route->params.use_mix = 0;
+	}
 #else
 	route->params.sum_idx = UINT64;
 #endif
@@ -916,6 +1325,64 @@ static const snd_pcm_ops_t snd_pcm_route_ops = {
 	.set_chmap = NULL, /* NYI */
 };
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/* group the sources of a destination by gain, in order of appearance */
+static int route_build_groups(snd_pcm_route_ttable_dst_t *dptr)
+{
+	snd_pcm_route_group_t *grp;
+	unsigned int *srcs;
+	unsigned int i, j;
+	char used[dptr->nsrcs];
+
+	grp = calloc(1, dptr->nsrcs * (sizeof(*grp) + sizeof(*srcs)));
+	if (!grp)
+		return -ENOMEM;
+	dptr->groups = grp;
+	srcs = (unsigned int *)(grp + dptr->nsrcs);
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < dptr->nsrcs; i++) {
+		if (used[i])
+			continue;
+		grp->gain = dptr->srcs[i].as_float;
+		grp->srcs = srcs;
+		for (j = i; j < dptr->nsrcs; j++) {
+			if (used[j] || dptr->srcs[j].as_float != grp->gain)
+				continue;
+			used[j] = 1;
+			grp->srcs[grp->nsrcs++] = dptr->srcs[j].channel;
+		}
+		srcs += grp->nsrcs;
+		grp++;
+	}
+	dptr->ngroups = grp - dptr->groups;
+	return 0;
+}
+
+/* list the sources which must be converted for mixing */
+static int route_build_mix_srcs(snd_pcm_route_params_t *params)
+{
+	unsigned int dst_channel, src_channel, i;
+	char used[params->nsrcs];
+
+	memset(used, 0, sizeof(used));
+	for (dst_channel = 0; dst_channel < params->ndsts; ++dst_channel) {
+		const snd_pcm_route_ttable_dst_t *dptr = &params->dsts[dst_channel];
+		if (route_mix_is_copy(dptr))
+			continue;
+		for (i = 0; i < dptr->nsrcs; i++)
+			used[dptr->srcs[i].channel] = 1;
+	}
+	params->mix_srcs = calloc(params->nsrcs + 1, sizeof(*params->mix_srcs));
+	if (!params->mix_srcs)
+		return -ENOMEM;
+	for (src_channel = 0; src_channel < params->nsrcs; ++src_channel) {
+		if (used[src_channel])
+			params->mix_srcs[params->mix_nsrcs++] = src_channel;
+	}
+	return 0;
+}
+#endif
+
 static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t stream,
 			     unsigned int tt_ssize,
 			     snd_pcm_route_ttable_entry_t *ttable,
@@ -981,9 +1448,17 @@ static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t st
 			memcpy(dptr->srcs, srcs, sizeof(*srcs) * nsrcs);
 		} else
 			dptr->srcs = 0;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+		if (nsrcs > 0 && route_build_groups(dptr) < 0)
+			return -ENOMEM;
+#endif
 		dptr++;
 	}
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	return route_build_mix_srcs(params);
+#else
 	return 0;
+#endif
 }
 
 /**
@@ -1028,6 +1503,7 @@ int snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	route->plug.write = snd_pcm_route_write_areas;
 	route->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	route->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	route->plug.fuse = 1;
 	route->plug.gen.slave = slave;
 	route->plug.gen.close_slave = close_slave;
 	route->plug.init = route_chmap_init;
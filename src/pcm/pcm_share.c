@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <string.h>
 #include <signal.h>
 #include <math.h>
@@ -88,7 +89,7 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
-	int poll[2];
+	int poll[2];		/* wakes up the thread, see snd_pcm_share_kick() */
 	int polling;
 	pthread_t thread;
 	pthread_mutex_t mutex;
@@ -350,6 +351,62 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 	return missing;
 }
 
+/*
+ * The avail_min of the slave which wakes up the thread when the slave
+ * hw_ptr reaches the period boundary at or after hw_ptr + missing.
+ */
+static snd_pcm_uframes_t snd_pcm_share_avail_min(snd_pcm_share_slave_t *slave,
+						 snd_pcm_uframes_t missing)
+{
+	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_sframes_t avail_min;
+
+	hw_ptr = slave->hw_ptr + missing;
+	hw_ptr += spcm->period_size - 1;
+	if (hw_ptr >= spcm->boundary)
+		hw_ptr -= spcm->boundary;
+	hw_ptr -= hw_ptr % spcm->period_size;
+	avail_min = hw_ptr - *spcm->appl.ptr;
+	if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
+		avail_min += spcm->buffer_size;
+	if (avail_min < 0)
+		avail_min += spcm->boundary;
+	return avail_min;
+}
+
+/*
+ * The slave wakes up only at period boundaries, so any avail_min which
+ * is not reached one period earlier wakes up the thread at the same
+ * time; the sw_params are changed only when the armed value is out of
+ * this window.
+ */
+static int snd_pcm_share_slave_arm(snd_pcm_share_slave_t *slave,
+				   snd_pcm_uframes_t avail_min)
+{
+	snd_pcm_t *spcm = slave->pcm;
+
+	if (spcm->avail_min <= avail_min &&
+	    spcm->avail_min + spcm->period_size > avail_min)
+		return 0;
+	snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
+	return snd_pcm_sw_params(spcm, &slave->sw_params);
+}
+
+/* Wake up the thread to reschedule; call it with mutex held */
+static void snd_pcm_share_kick(snd_pcm_share_slave_t *slave)
+{
+	char buf[1] = { 0 };
+
+	if (!slave->polling) {
+		pthread_cond_signal(&slave->poll_cond);
+		return;
+	}
+	/* the pipe is non-blocking, a full pipe means a pending wakeup */
+	if (write(slave->poll[1], buf, 1) < 0 && errno != EAGAIN)
+		SYSMSG("share wakeup failed");
+}
+
 static void *snd_pcm_share_thread(void *data)
 {
 	snd_pcm_share_slave_t *slave = data;
@@ -365,47 +422,27 @@ static void *snd_pcm_share_thread(void *data)
 		return NULL;
 	}
 	Pthread_mutex_lock(&slave->mutex);
-	err = pipe(slave->poll);
-	if (err < 0) {
-		SYSERR("can't create a pipe");
-		Pthread_mutex_unlock(&slave->mutex);
-		return NULL;
-	}
 	while (slave->open_count > 0) {
 		snd_pcm_uframes_t missing;
 		// printf("begin min_missing\n");
 		missing = _snd_pcm_share_slave_missing(slave);
 		// printf("min_missing=%ld\n", missing);
 		if (missing < INT_MAX) {
-			snd_pcm_uframes_t hw_ptr;
-			snd_pcm_sframes_t avail_min;
-			hw_ptr = slave->hw_ptr + missing;
-			hw_ptr += spcm->period_size - 1;
-			if (hw_ptr >= spcm->boundary)
-				hw_ptr -= spcm->boundary;
-			hw_ptr -= hw_ptr % spcm->period_size;
-			avail_min = hw_ptr - *spcm->appl.ptr;
-			if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
-				avail_min += spcm->buffer_size;
-			if (avail_min < 0)
-				avail_min += spcm->boundary;
-			// printf("avail_min=%d\n", avail_min);
-			if ((snd_pcm_uframes_t)avail_min != spcm->avail_min) {
-				snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-				err = snd_pcm_sw_params(spcm, &slave->sw_params);
-				if (err < 0) {
-					SYSERR("snd_pcm_sw_params error");
-					Pthread_mutex_unlock(&slave->mutex);
-					return NULL;
-				}
+			err = snd_pcm_share_slave_arm(slave,
+					snd_pcm_share_avail_min(slave, missing));
+			if (err < 0) {
+				SYSERR("snd_pcm_sw_params error");
+				Pthread_mutex_unlock(&slave->mutex);
+				return NULL;
 			}
 			slave->polling = 1;
 			Pthread_mutex_unlock(&slave->mutex);
 			err = poll(pfd, 2, -1);
 			Pthread_mutex_lock(&slave->mutex);
 			if (pfd[0].revents & POLLIN) {
-				char buf[1];
-				read(pfd[0].fd, buf, 1);
+				char buf[16];
+				while (read(pfd[0].fd, buf, sizeof(buf)) == sizeof(buf))
+					;
 			}
 		} else {
 			slave->polling = 0;
@@ -426,33 +463,11 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 	slave->hw_ptr = *slave->pcm->hw.ptr;
 	missing = _snd_pcm_share_missing(pcm);
 	// printf("missing %ld\n", missing);
-	if (!slave->polling) {
-		pthread_cond_signal(&slave->poll_cond);
-		return;
-	}
-	if (missing < INT_MAX) {
-		snd_pcm_uframes_t hw_ptr;
-		snd_pcm_sframes_t avail_min;
-		hw_ptr = slave->hw_ptr + missing;
-		hw_ptr += spcm->period_size - 1;
-		if (hw_ptr >= spcm->boundary)
-			hw_ptr -= spcm->boundary;
-		hw_ptr -= hw_ptr % spcm->period_size;
-		avail_min = hw_ptr - *spcm->appl.ptr;
-		if (spcm->stream == SND_PCM_STREAM_PLAYBACK)
-			avail_min += spcm->buffer_size;
-		if (avail_min < 0)
-			avail_min += spcm->boundary;
-		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min) {
-			int err;
-			snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-			err = snd_pcm_sw_params(spcm, &slave->sw_params);
-			if (err < 0) {
-				SYSERR("snd_pcm_sw_params error");
-				return;
-			}
-		}
-	}
+	/* the thread reprograms the slave only if it must wake up earlier */
+	if (!slave->polling ||
+	    (missing < INT_MAX &&
+	     snd_pcm_share_avail_min(slave, missing) < spcm->avail_min))
+		snd_pcm_share_kick(slave);
 }
 
 static int snd_pcm_share_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
@@ -1259,16 +1274,18 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 	Pthread_mutex_lock(&slave->mutex);
 	slave->open_count--;
 	if (slave->open_count == 0) {
-		pthread_cond_signal(&slave->poll_cond);
+		snd_pcm_share_kick(slave);
 		Pthread_mutex_unlock(&slave->mutex);
 		err = pthread_join(slave->thread, 0);
 		assert(err == 0);
 		err = snd_pcm_close(slave->pcm);
 		pthread_mutex_destroy(&slave->mutex);
 		pthread_cond_destroy(&slave->poll_cond);
+		close(slave->poll[0]);
+		close(slave->poll[1]);
+		list_del(&share->list);
 		list_del(&slave->list);
 		free(slave);
-		list_del(&share->list);
 	} else {
 		list_del(&share->list);
 		Pthread_mutex_unlock(&slave->mutex);
@@ -1484,6 +1501,20 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 			free(share);
 			return err;
 		}
+		if (pipe(slave->poll) < 0) {
+			err = -errno;
+			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
+			free(slave);
+			snd_pcm_close(spcm);
+			close(sd[0]);
+			close(sd[1]);
+			snd_pcm_free(pcm);
+			free(share->slave_channels);
+			free(share);
+			return err;
+		}
+		fcntl(slave->poll[0], F_SETFL, O_NONBLOCK);
+		fcntl(slave->poll[1], F_SETFL, O_NONBLOCK);
 		INIT_LIST_HEAD(&slave->clients);
 		slave->pcm = spcm;
 		slave->channels = schannels;
@@ -54,7 +54,24 @@ const char *_snd_module_pcm_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_pcm_shm_ctrl_t *ctrl;
+	unsigned int fresh;	/* SHM_FRESH_* answers pending in ctrl->status */
+	int xfer;		/* inside a read or write call */
+	int has_status;		/* the server keeps ctrl->status */
 } snd_pcm_shm_t;
+
+/*
+ * mmap_commit returns the state and avail synced right after the commit
+ * in the status block, so the state, hwsync and avail_update calls of
+ * the next transfer iteration are answered once each without a round
+ * trip.  Likewise the first state query of a read or write call syncs
+ * and fetches all three at once.  They are trusted only within the same
+ * read or write call and until a wait; any other command invalidates
+ * them.  With an older server, which doesn't keep the status block,
+ * every call is a round trip as before.
+ */
+#define SHM_FRESH_STATE		(1<<0)
+#define SHM_FRESH_HWSYNC	(1<<1)
+#define SHM_FRESH_AVAIL		(1<<2)
 #endif
 
 static long snd_pcm_shm_action_fd0(snd_pcm_t *pcm, int *fd)
@@ -116,6 +133,7 @@ static long snd_pcm_shm_action(snd_pcm_t *pcm)
 	char buf[1];
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 
+	shm->fresh = 0;
 	if (ctrl->hw.changed || ctrl->appl.changed)
 		return -EBADFD;
 	err = write(shm->socket, buf, 1);
@@ -151,6 +169,7 @@ static long snd_pcm_shm_action_fd(snd_pcm_t *pcm, int *fd)
 	char buf[1];
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 
+	shm->fresh = 0;
 	if (ctrl->hw.changed || ctrl->appl.changed)
 		return -EBADFD;
 	err = write(shm->socket, buf, 1);
@@ -404,6 +423,18 @@ static snd_pcm_state_t snd_pcm_shm_state(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (shm->fresh & SHM_FRESH_STATE) {
+		shm->fresh &= ~SHM_FRESH_STATE;
+		return ctrl->status.state;
+	}
+	if (shm->xfer) {
+		/* a transfer iteration starts, get all its answers at once */
+		ctrl->cmd = SND_PCM_IOCTL_SYNC_STATUS;
+		if (snd_pcm_shm_action(pcm) >= 0) {
+			shm->fresh = SHM_FRESH_HWSYNC | SHM_FRESH_AVAIL;
+			return ctrl->status.state;
+		}
+	}
 	ctrl->cmd = SND_PCM_IOCTL_STATE;
 	return snd_pcm_shm_action(pcm);
 }
@@ -412,6 +443,10 @@ static int snd_pcm_shm_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (shm->fresh & SHM_FRESH_HWSYNC) {
+		shm->fresh &= ~SHM_FRESH_HWSYNC;
+		return 0;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_HWSYNC;
 	return snd_pcm_shm_action(pcm);
 }
@@ -434,18 +469,33 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 	int err;
+	if (shm->fresh & SHM_FRESH_AVAIL) {
+		shm->fresh &= ~SHM_FRESH_AVAIL;
+		return ctrl->status.avail;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_AVAIL_UPDATE;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
 		return err;
+	if (shm->xfer)
+		shm->fresh = SHM_FRESH_STATE;
 	return err;
 }
 
-static int snd_pcm_shm_htimestamp(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-				  snd_pcm_uframes_t *avail ATTRIBUTE_UNUSED,
-				  snd_htimestamp_t *tstamp ATTRIBUTE_UNUSED)
+static int snd_pcm_shm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
+				  snd_htimestamp_t *tstamp)
 {
-	return -EIO;	/* not implemented yet */
+	snd_pcm_shm_t *shm = pcm->private_data;
+	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (!shm->has_status)
+		return -EIO;	/* not implemented by the server */
+	/* the timestamp of the last avail_update or mmap_commit */
+	if (ctrl->status.tstamp_result < 0)
+		return ctrl->status.tstamp_result;
+	*avail = ctrl->status.tstamp_avail;
+	tstamp->tv_sec = ctrl->status.tstamp.tv_sec;
+	tstamp->tv_nsec = ctrl->status.tstamp.tv_nsec;
+	return 0;
 }
 
 static int snd_pcm_shm_prepare(snd_pcm_t *pcm)
@@ -550,10 +600,68 @@ static snd_pcm_sframes_t snd_pcm_shm_mmap_commit(snd_pcm_t *pcm,
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_sframes_t result;
 	ctrl->cmd = SND_PCM_IOCTL_MMAP_COMMIT;
 	ctrl->u.mmap_commit.offset = offset;
 	ctrl->u.mmap_commit.frames = size;
-	return snd_pcm_shm_action(pcm);
+	result = snd_pcm_shm_action(pcm);
+	if (result >= 0 && shm->xfer)
+		shm->fresh = SHM_FRESH_STATE | SHM_FRESH_HWSYNC | SHM_FRESH_AVAIL;
+	return result;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_xfer_end(snd_pcm_t *pcm,
+					       snd_pcm_sframes_t result)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	shm->xfer = 0;
+	shm->fresh = 0;
+	return result;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_writei(snd_pcm_t *pcm, const void *buffer,
+					    snd_pcm_uframes_t size)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	shm->xfer = shm->has_status;
+	return snd_pcm_shm_xfer_end(pcm, snd_pcm_mmap_writei(pcm, buffer, size));
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_writen(snd_pcm_t *pcm, void **bufs,
+					    snd_pcm_uframes_t size)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	shm->xfer = shm->has_status;
+	return snd_pcm_shm_xfer_end(pcm, snd_pcm_mmap_writen(pcm, bufs, size));
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_readi(snd_pcm_t *pcm, void *buffer,
+					   snd_pcm_uframes_t size)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	shm->xfer = shm->has_status;
+	return snd_pcm_shm_xfer_end(pcm, snd_pcm_mmap_readi(pcm, buffer, size));
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_readn(snd_pcm_t *pcm, void **bufs,
+					   snd_pcm_uframes_t size)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	shm->xfer = shm->has_status;
+	return snd_pcm_shm_xfer_end(pcm, snd_pcm_mmap_readn(pcm, bufs, size));
+}
+
+/* the status block is stale once the caller waited */
+static int snd_pcm_shm_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				    unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+
+	shm->fresh = 0;
+	if (nfds != 1)
+		return -EINVAL;
+	*revents = pfds->revents;
+	return 0;
 }
 
 static int snd_pcm_shm_poll_descriptor(snd_pcm_t *pcm)
@@ -622,13 +730,14 @@ static const snd_pcm_fast_ops_t snd_pcm_shm_fast_ops = {
 	.forwardable = snd_pcm_shm_forwardable,
 	.forward = snd_pcm_shm_forward,
 	.resume = snd_pcm_shm_resume,
-	.writei = snd_pcm_mmap_writei,
-	.writen = snd_pcm_mmap_writen,
-	.readi = snd_pcm_mmap_readi,
-	.readn = snd_pcm_mmap_readn,
+	.writei = snd_pcm_shm_writei,
+	.writen = snd_pcm_shm_writen,
+	.readi = snd_pcm_shm_readi,
+	.readn = snd_pcm_shm_readn,
 	.avail_update = snd_pcm_shm_avail_update,
 	.mmap_commit = snd_pcm_shm_mmap_commit,
 	.htimestamp = snd_pcm_shm_htimestamp,
+	.poll_revents = snd_pcm_shm_poll_revents,
 };
 
 static int make_local_socket(const char *filename)
@@ -679,6 +788,7 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	int err;
 	int result;
 	snd_pcm_shm_ctrl_t *ctrl = NULL;
+	struct shmid_ds shmds;
 	int sock = -1;
 	snamelen = strlen(sname);
 	if (snamelen > 255)
@@ -740,6 +850,10 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 
 	shm->socket = sock;
 	shm->ctrl = ctrl;
+	/* an older server has a shorter segment without the status block */
+	if (shmctl(ans.cookie, IPC_STAT, &shmds) >= 0 &&
+	    shmds.shm_segsz >= sizeof(snd_pcm_shm_ctrl_t))
+		shm->has_status = 1;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_SHM, name, stream, mode);
 	if (err < 0) {
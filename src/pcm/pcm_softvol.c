@@ -31,6 +31,12 @@
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_softvol = "";
@@ -51,8 +57,20 @@ typedef struct {
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	int ramp;		/* SOFTVOL_RAMP_XXX */
+	int ramp_valid;		/* ramp_to holds the current volume */
+	unsigned int ramp_len;	/* ramp length in frames (a period) */
+	unsigned int ramp_pos;
+	unsigned int ramp_from[3];	/* left, right, center */
+	unsigned int ramp_to[3];
 } snd_pcm_softvol_t;
 
+enum {
+	SOFTVOL_RAMP_NONE,
+	SOFTVOL_RAMP_LINEAR,
+	SOFTVOL_RAMP_EXPONENTIAL,
+};
+
 #define VOL_SCALE_SHIFT		16
 #define VOL_SCALE_MASK          ((1 << VOL_SCALE_SHIFT) - 1)
 
@@ -146,8 +164,8 @@ static inline int MULTI_DIV_24(int a, unsigned int b)
 		long long amp = (long long)a * gain + fraction;
 		if (amp > (int)0x7fffff)
 			amp = (int)0x7fffff;
-		else if (amp < (int)0x800000)
-			amp = (int)0x800000;
+		else if (amp < (int)0xff800000)
+			amp = (int)0xff800000;
 		return (int)amp;
 	}
 	return fraction;
@@ -168,15 +186,356 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	return swap ? (short)bswap_16((short)fraction) : (short)fraction;
 }
 
+#ifndef HAVE_SOFT_FLOAT
+static inline float MULTI_DIV_float(float a, unsigned int b, int swap ATTRIBUTE_UNUSED)
+{
+	return a * ((float)b / (1 << VOL_SCALE_SHIFT));
+}
+#endif
+
 #endif /* DOC_HIDDEN */
 
 /*
  * apply volumue attenuation
- *
- * TODO: use SIMD operations
  */
 
 #ifndef DOC_HIDDEN
+
+/*
+ * bulk kernels for contiguous native-endian samples; sample i is scaled
+ * with vols[i % nvols], so that an interleaved buffer is handled in one go.
+ * The results are identical to MULTI_DIV_xxx(), 0xffff is the unity gain.
+ */
+typedef void (*softvol_bulk_t)(void *dst, const void *src,
+			       unsigned int samples,
+			       const unsigned int *vols, unsigned int nvols);
+
+/* the kernels keep a per-lane copy of the volume pattern on the stack */
+#define SOFTVOL_BULK_MAX_VOLS	32
+
+static inline int softvol_scale_int(int a, unsigned int vol, int max)
+{
+	long long amp;
+
+	if (vol == 0xffff)
+		return a;
+	amp = ((long long)a * vol) >> VOL_SCALE_SHIFT;
+	if (amp > max)
+		return max;
+	if (amp < -max - 1)
+		return -max - 1;
+	return amp;
+}
+
+#if defined(__SSE2__)
+
+static void softvol_bulk_s16(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int16_t *d = dst;
+	const int16_t *s = src;
+	unsigned int period = nvols * 8, i, k = 0;
+	int16_t gain[period], frac[period];
+
+	for (i = 0; i < period; i++) {
+		unsigned int vol = vols[i % nvols];
+		if (vol == 0xffff)
+			vol = 1 << VOL_SCALE_SHIFT;
+		gain[i] = vol >> VOL_SCALE_SHIFT;
+		frac[i] = vol & VOL_SCALE_MASK;
+	}
+	for (; samples >= 8; samples -= 8, s += 8, d += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i g = _mm_loadu_si128((const __m128i *)(gain + k));
+		__m128i f = _mm_loadu_si128((const __m128i *)(frac + k));
+		/* (a * frac) >> 16 with frac taken as unsigned */
+		__m128i fr = _mm_add_epi16(_mm_mulhi_epi16(a, f),
+					   _mm_and_si128(a, _mm_srai_epi16(f, 15)));
+		__m128i pl = _mm_mullo_epi16(a, g);
+		__m128i ph = _mm_mulhi_epi16(a, g);
+		__m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(pl, ph),
+					   _mm_srai_epi32(_mm_unpacklo_epi16(fr, fr), 16));
+		__m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(pl, ph),
+					   _mm_srai_epi32(_mm_unpackhi_epi16(fr, fr), 16));
+		_mm_storeu_si128((__m128i *)d, _mm_packs_epi32(lo, hi));
+		k += 8;
+		if (k == period)
+			k = 0;
+	}
+	for (i = 0; i < samples; i++)
+		d[i] = softvol_scale_int(s[i], vols[(k + i) % nvols], 0x7fff);
+}
+
+/* a double holds the full product, so that the result is simply floored
+ * and clipped
+ */
+static inline __m128i softvol_sse2_s32(__m128d v)
+{
+	__m128d t;
+
+	v = _mm_min_pd(_mm_max_pd(v, _mm_set1_pd(-2147483648.0)),
+		       _mm_set1_pd(2147483647.0));
+	t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+	t = _mm_sub_pd(t, _mm_and_pd(_mm_cmplt_pd(v, t), _mm_set1_pd(1.0)));
+	return _mm_cvttpd_epi32(t);
+}
+
+static void softvol_bulk_s32(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+	unsigned int period = nvols * 4, i, k = 0;
+	double gain[period];
+
+	for (i = 0; i < period; i++) {
+		unsigned int vol = vols[i % nvols];
+		gain[i] = vol == 0xffff ? 1.0 : (double)vol / (1 << VOL_SCALE_SHIFT);
+	}
+	for (; samples >= 4; samples -= 4, s += 4, d += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i lo = softvol_sse2_s32(_mm_mul_pd(_mm_cvtepi32_pd(a),
+							 _mm_loadu_pd(gain + k)));
+		__m128i hi = softvol_sse2_s32(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)),
+							 _mm_loadu_pd(gain + k + 2)));
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(lo, hi));
+		k += 4;
+		if (k == period)
+			k = 0;
+	}
+	for (i = 0; i < samples; i++)
+		d[i] = softvol_scale_int(s[i], vols[(k + i) % nvols], 0x7fffffff);
+}
+
+static void softvol_bulk_float(void *dst, const void *src, unsigned int samples,
+			       const unsigned int *vols, unsigned int nvols)
+{
+	float *d = dst;
+	const float *s = src;
+	unsigned int period = nvols * 4, i, k = 0;
+	float gain[period];
+
+	for (i = 0; i < period; i++) {
+		unsigned int vol = vols[i % nvols];
+		gain[i] = vol == 0xffff ? 1.0f : (float)vol / (1 << VOL_SCALE_SHIFT);
+	}
+	for (; samples >= 4; samples -= 4, s += 4, d += 4) {
+		_mm_storeu_ps(d, _mm_mul_ps(_mm_loadu_ps(s), _mm_loadu_ps(gain + k)));
+		k += 4;
+		if (k == period)
+			k = 0;
+	}
+	for (i = 0; i < samples; i++)
+		d[i] = s[i] * gain[k + i];
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static void softvol_bulk_s16(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int16_t *d = dst;
+	const int16_t *s = src;
+	unsigned int period = nvols * 4, i, k = 0;
+	int32_t gain[period], frac[period];
+
+	for (i = 0; i < period; i++) {
+		unsigned int vol = vols[i % nvols];
+		if (vol == 0xffff)
+			vol = 1 << VOL_SCALE_SHIFT;
+		gain[i] = vol >> VOL_SCALE_SHIFT;
+		frac[i] = vol & VOL_SCALE_MASK;
+	}
+	for (; samples >= 4; samples -= 4, s += 4, d += 4) {
+		int32x4_t a = vmovl_s16(vld1_s16(s));
+		int32x4_t amp = vaddq_s32(vmulq_s32(a, vld1q_s32(gain + k)),
+					  vshrq_n_s32(vmulq_s32(a, vld1q_s32(frac + k)),
+						      VOL_SCALE_SHIFT));
+		vst1_s16(d, vqmovn_s32(amp));
+		k += 4;
+		if (k == period)
+			k = 0;
+	}
+	for (i = 0; i < samples; i++)
+		d[i] = softvol_scale_int(s[i], vols[(k + i) % nvols], 0x7fff);
+}
+
+/* no 64bit products in ARMv7 NEON */
+static void softvol_bulk_s32(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+	unsigned int i, k = 0;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = softvol_scale_int(s[i], vols[k], 0x7fffffff);
+		if (++k == nvols)
+			k = 0;
+	}
+}
+
+static void softvol_bulk_float(void *dst, const void *src, unsigned int samples,
+			       const unsigned int *vols, unsigned int nvols)
+{
+	float *d = dst;
+	const float *s = src;
+	unsigned int period = nvols * 4, i, k = 0;
+	float gain[period];
+
+	for (i = 0; i < period; i++) {
+		unsigned int vol = vols[i % nvols];
+		gain[i] = vol == 0xffff ? 1.0f : (float)vol / (1 << VOL_SCALE_SHIFT);
+	}
+	for (; samples >= 4; samples -= 4, s += 4, d += 4) {
+		vst1q_f32(d, vmulq_f32(vld1q_f32(s), vld1q_f32(gain + k)));
+		k += 4;
+		if (k == period)
+			k = 0;
+	}
+	for (i = 0; i < samples; i++)
+		d[i] = s[i] * gain[k + i];
+}
+
+#else
+
+static void softvol_bulk_s16(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int16_t *d = dst;
+	const int16_t *s = src;
+	unsigned int i, k = 0;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = softvol_scale_int(s[i], vols[k], 0x7fff);
+		if (++k == nvols)
+			k = 0;
+	}
+}
+
+static void softvol_bulk_s32(void *dst, const void *src, unsigned int samples,
+			     const unsigned int *vols, unsigned int nvols)
+{
+	int32_t *d = dst;
+	const int32_t *s = src;
+	unsigned int i, k = 0;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = softvol_scale_int(s[i], vols[k], 0x7fffffff);
+		if (++k == nvols)
+			k = 0;
+	}
+}
+
+#ifndef HAVE_SOFT_FLOAT
+static void softvol_bulk_float(void *dst, const void *src, unsigned int samples,
+			       const unsigned int *vols, unsigned int nvols)
+{
+	float *d = dst;
+	const float *s = src;
+	unsigned int i, k = 0;
+
+	for (i = 0; i < samples; i++) {
+		d[i] = vols[k] == 0xffff ? s[i] : MULTI_DIV_float(s[i], vols[k], 0);
+		if (++k == nvols)
+			k = 0;
+	}
+}
+#endif
+
+#endif
+
+/* S24_3LE is unpacked and packed again around the 32bit product */
+static void softvol_bulk_s24_3le(void *dst, const void *src, unsigned int samples,
+				 const unsigned int *vols, unsigned int nvols)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	unsigned int i, k = 0;
+	int tmp;
+
+	for (i = 0; i < samples; i++, s += 3, d += 3) {
+		tmp = s[0] | (s[1] << 8) | (((signed char *)s)[2] << 16);
+		tmp = softvol_scale_int(tmp, vols[k], 0x7fffff);
+		d[0] = tmp;
+		d[1] = tmp >> 8;
+		d[2] = tmp >> 16;
+		if (++k == nvols)
+			k = 0;
+	}
+}
+
+static int softvol_areas_packed(const snd_pcm_channel_area_t *areas,
+				unsigned int channels, unsigned int width)
+{
+	unsigned int ch;
+
+	if (areas[0].step != channels * width || areas[0].first % 8)
+		return 0;
+	for (ch = 1; ch < channels; ch++) {
+		if (areas[ch].addr != areas[0].addr ||
+		    areas[ch].step != areas[0].step ||
+		    areas[ch].first != areas[0].first + ch * width)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * apply the per-channel volumes with the bulk kernels;
+ * returns zero if the format or the layout isn't suitable
+ */
+static int softvol_convert_bulk(snd_pcm_softvol_t *svol,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset,
+				unsigned int channels,
+				snd_pcm_uframes_t frames,
+				const unsigned int *vols)
+{
+	softvol_bulk_t func;
+	unsigned int width, ch;
+
+	switch (svol->sformat) {
+	case SND_PCM_FORMAT_S16:
+		func = softvol_bulk_s16;
+		break;
+	case SND_PCM_FORMAT_S32:
+		func = softvol_bulk_s32;
+		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		func = softvol_bulk_float;
+		break;
+#endif
+	case SND_PCM_FORMAT_S24_3LE:
+		func = softvol_bulk_s24_3le;
+		break;
+	default:
+		return 0;
+	}
+	width = snd_pcm_format_physical_width(svol->sformat);
+	if (channels <= SOFTVOL_BULK_MAX_VOLS &&
+	    softvol_areas_packed(src_areas, channels, width) &&
+	    softvol_areas_packed(dst_areas, channels, width)) {
+		func(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		     snd_pcm_channel_area_addr(src_areas, src_offset),
+		     frames * channels, vols, channels);
+		return 1;
+	}
+	for (ch = 0; ch < channels; ch++) {
+		if (src_areas[ch].step != width || dst_areas[ch].step != width ||
+		    src_areas[ch].first % 8 || dst_areas[ch].first % 8)
+			return 0;
+	}
+	for (ch = 0; ch < channels; ch++)
+		func(snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset),
+		     snd_pcm_channel_area_addr(&src_areas[ch], src_offset),
+		     frames, &vols[ch], 1);
+	return 1;
+}
+
 #define CONVERT_AREA(TYPE, swap) do {	\
 	unsigned int ch, fr; \
 	TYPE *src, *dst; \
@@ -281,6 +640,7 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 	const snd_pcm_channel_area_t *dst_area, *src_area;
 	unsigned int src_step, dst_step;
 	unsigned int vol_scale, vol[2], vol_c;
+	unsigned int ch, vols[channels];
 
 	if (svol->cur_vol[0] == 0 && svol->cur_vol[1] == 0) {
 		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
@@ -302,6 +662,13 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 		vol[1] = svol->dB_value[svol->cur_vol[1]];
 		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
 	}
+	for (ch = 0; ch < channels; ch++) {
+		GET_VOL_SCALE;
+		vols[ch] = vol_scale;
+	}
+	if (softvol_convert_bulk(svol, dst_areas, dst_offset, src_areas,
+				 src_offset, channels, frames, vols))
+		return;
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -318,6 +685,11 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		CONVERT_AREA(float, 0);
+		break;
+#endif
 	default:
 		break;
 	}
@@ -338,6 +710,7 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	const snd_pcm_channel_area_t *dst_area, *src_area;
 	unsigned int src_step, dst_step;
 	unsigned int vol_scale;
+	unsigned int ch, vols[channels];
 
 	if (svol->cur_vol[0] == 0) {
 		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
@@ -353,6 +726,11 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
 	else
 		vol_scale = svol->dB_value[svol->cur_vol[0]];
+	for (ch = 0; ch < channels; ch++)
+		vols[ch] = vol_scale;
+	if (softvol_convert_bulk(svol, dst_areas, dst_offset, src_areas,
+				 src_offset, channels, frames, vols))
+		return;
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -369,11 +747,174 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		CONVERT_AREA(float, 0);
+		break;
+#endif
 	default:
 		break;
 	}
 }
 
+/*
+ * volume ramps
+ *
+ * A volume change doesn't take effect at once but the scale of each
+ * control channel moves from the old value to the new one over a period.
+ */
+
+/* left, right and center scales of the current volume */
+static void softvol_get_scales(snd_pcm_softvol_t *svol, unsigned int *scale)
+{
+	unsigned int vol1 = svol->cchannels == 1 ? svol->cur_vol[0] : svol->cur_vol[1];
+
+	if (svol->max_val == 1) {
+		scale[0] = svol->cur_vol[0] ? 0xffff : 0;
+		scale[1] = vol1 ? 0xffff : 0;
+		scale[2] = scale[0] | scale[1];
+	} else {
+		scale[0] = svol->dB_value[svol->cur_vol[0]];
+		scale[1] = svol->dB_value[vol1];
+		scale[2] = svol->dB_value[(svol->cur_vol[0] + vol1) / 2];
+	}
+}
+
+static unsigned int softvol_ramp_scale(snd_pcm_softvol_t *svol, unsigned int idx,
+				       unsigned int pos)
+{
+	unsigned int from = svol->ramp_from[idx], to = svol->ramp_to[idx];
+
+	if (pos >= svol->ramp_len || from == to)
+		return to;
+#ifndef HAVE_SOFT_FLOAT
+	/* constant dB steps; a ramp from or to mute falls back to linear */
+	if (svol->ramp == SOFTVOL_RAMP_EXPONENTIAL && from && to)
+		return from * pow((double)to / from, (double)pos / svol->ramp_len);
+#endif
+	return from + ((long long)to - from) * pos / svol->ramp_len;
+}
+
+static void softvol_update_ramp(snd_pcm_softvol_t *svol)
+{
+	unsigned int scale[3], i;
+
+	softvol_get_scales(svol, scale);
+	if (!svol->ramp_valid) {
+		memcpy(svol->ramp_to, scale, sizeof(scale));
+		svol->ramp_pos = svol->ramp_len;
+		svol->ramp_valid = 1;
+		return;
+	}
+	if (!memcmp(svol->ramp_to, scale, sizeof(scale)))
+		return;
+	/* restart from where a running ramp is */
+	for (i = 0; i < 3; i++)
+		svol->ramp_from[i] = softvol_ramp_scale(svol, i, svol->ramp_pos);
+	memcpy(svol->ramp_to, scale, sizeof(scale));
+	svol->ramp_pos = 0;
+}
+
+static void softvol_scale_sample(snd_pcm_format_t format, char *dst,
+				 const char *src, unsigned int vol_scale)
+{
+	int tmp;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		*(short *)dst = vol_scale == 0xffff ? *(const short *)src :
+			MULTI_DIV_short(*(const short *)src, vol_scale,
+					!snd_pcm_format_cpu_endian(format));
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		*(int *)dst = vol_scale == 0xffff ? *(const int *)src :
+			MULTI_DIV_int(*(const int *)src, vol_scale,
+				      !snd_pcm_format_cpu_endian(format));
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		tmp = (unsigned char)src[0] | ((unsigned char)src[1] << 8) |
+		      (((signed char *)src)[2] << 16);
+		if (vol_scale != 0xffff)
+			tmp = MULTI_DIV_24(tmp, vol_scale);
+		dst[0] = tmp;
+		dst[1] = tmp >> 8;
+		dst[2] = tmp >> 16;
+		break;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+		*(float *)dst = vol_scale == 0xffff ? *(const float *)src :
+			MULTI_DIV_float(*(const float *)src, vol_scale, 0);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+/* apply the running ramp, frame by frame */
+static void softvol_convert_ramp(snd_pcm_softvol_t *svol,
+				 const snd_pcm_channel_area_t *dst_areas,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas,
+				 snd_pcm_uframes_t src_offset,
+				 unsigned int channels,
+				 snd_pcm_uframes_t frames)
+{
+	unsigned int ch, idx[channels];
+	snd_pcm_uframes_t fr;
+
+	for (ch = 0; ch < channels; ch++) {
+		if (svol->cchannels == 1)
+			idx[ch] = 0;
+		else if (ch == 4 || ch == 5 ||
+			 ((ch == 0 || ch == 2) && channels == ch + 1))
+			idx[ch] = 2;	/* see GET_VOL_SCALE */
+		else
+			idx[ch] = ch & 1;
+	}
+	for (fr = 0; fr < frames; fr++) {
+		unsigned int scale[3], i;
+		for (i = 0; i < 3; i++)
+			scale[i] = softvol_ramp_scale(svol, i, svol->ramp_pos);
+		for (ch = 0; ch < channels; ch++)
+			softvol_scale_sample(svol->sformat,
+					     snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset + fr),
+					     snd_pcm_channel_area_addr(&src_areas[ch], src_offset + fr),
+					     scale[idx[ch]]);
+		svol->ramp_pos++;
+	}
+}
+
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames)
+{
+	if (svol->ramp_pos < svol->ramp_len) {
+		snd_pcm_uframes_t size = svol->ramp_len - svol->ramp_pos;
+		if (size > frames)
+			size = frames;
+		softvol_convert_ramp(svol, dst_areas, dst_offset,
+				     src_areas, src_offset, channels, size);
+		dst_offset += size;
+		src_offset += size;
+		frames -= size;
+		if (!frames)
+			return;
+	}
+	if (svol->cchannels == 1)
+		softvol_convert_mono_vol(svol, dst_areas, dst_offset,
+					 src_areas, src_offset, channels, frames);
+	else
+		softvol_convert_stereo_vol(svol, dst_areas, dst_offset,
+					   src_areas, src_offset, channels, frames);
+}
+
 /*
  * get the current volume value from driver
  *
@@ -392,6 +933,8 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 			val = svol->max_val;
 		svol->cur_vol[i] = val;
 	}
+	if (svol->ramp != SOFTVOL_RAMP_NONE)
+		softvol_update_ramp(svol);
 }
 
 static void softvol_free(snd_pcm_softvol_t *svol)
@@ -423,7 +966,11 @@ static int snd_pcm_softvol_hw_refine_cprepare(snd_pcm_t *pcm,
 			(1ULL << SND_PCM_FORMAT_S16_LE) |
 			(1ULL << SND_PCM_FORMAT_S16_BE) |
 			(1ULL << SND_PCM_FORMAT_S32_LE) |
- 			(1ULL << SND_PCM_FORMAT_S32_BE),
+ 			(1ULL << SND_PCM_FORMAT_S32_BE)
+#ifndef HAVE_SOFT_FLOAT
+			| (1ULL << SND_PCM_FORMAT_FLOAT)
+#endif
+			,
 			(1ULL << (SND_PCM_FORMAT_S24_3LE - 32))
 		}
 	};
@@ -563,6 +1110,23 @@ static int snd_pcm_softvol_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 				       snd_pcm_generic_hw_refine);
 }
 
+static int softvol_format_supported(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+	case SND_PCM_FORMAT_S24_3LE:
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+#ifndef HAVE_SOFT_FLOAT
+	case SND_PCM_FORMAT_FLOAT:
+#endif
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_softvol_t *svol = pcm->private_data;
@@ -574,16 +1138,20 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 					  snd_pcm_generic_hw_params);
 	if (err < 0)
 		return err;
-	if (slave->format != SND_PCM_FORMAT_S16_LE &&
-	    slave->format != SND_PCM_FORMAT_S16_BE &&
-	    slave->format != SND_PCM_FORMAT_S24_3LE && 
-	    slave->format != SND_PCM_FORMAT_S32_LE &&
-	    slave->format != SND_PCM_FORMAT_S32_BE) {
-		SNDERR("softvol supports only S16_LE, S16_BE, S24_3LE, S32_LE "
-		       " or S32_BE");
+	if (!softvol_format_supported(slave->format)) {
+		SNDERR("softvol supports only S16_LE, S16_BE, S24_3LE, S32_LE, "
+		       "S32_BE or FLOAT");
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	if (svol->ramp != SOFTVOL_RAMP_NONE) {
+		snd_pcm_uframes_t period_size;
+		err = INTERNAL(snd_pcm_hw_params_get_period_size)(params, &period_size, 0);
+		if (err < 0)
+			return err;
+		svol->ramp_len = period_size;
+		svol->ramp_valid = 0;
+	}
 	return 0;
 }
 
@@ -600,12 +1168,8 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_convert(svol, slave_areas, slave_offset,
+			areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -623,12 +1187,8 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_convert(svol, areas, offset, slave_areas,
+			slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -645,6 +1205,10 @@ static void snd_pcm_softvol_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "max_dB: %g\n", svol->max_dB);
 		snd_output_printf(out, "resolution: %d\n", svol->max_val + 1);
 	}
+	if (svol->ramp == SOFTVOL_RAMP_LINEAR)
+		snd_output_printf(out, "ramp: linear\n");
+	else if (svol->ramp == SOFTVOL_RAMP_EXPONENTIAL)
+		snd_output_printf(out, "ramp: exponential\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -823,41 +1387,19 @@ static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.set_chmap = snd_pcm_generic_set_chmap,
 };
 
-/**
- * \brief Creates a new SoftVolume PCM
- * \param pcmp Returns created PCM handle
- * \param name Name of PCM
- * \param sformat Slave format
- * \param ctl_card card index of the control
- * \param ctl_id The control element
- * \param cchannels PCM channels
- * \param min_dB minimal dB value
- * \param max_dB maximal dB value
- * \param resolution resolution of control
- * \param slave Slave PCM handle
- * \param close_slave When set, the slave PCM handle is closed with copy PCM
- * \retval zero on success otherwise a negative error code
- * \warning Using of this function might be dangerous in the sense
- *          of compatibility reasons. The prototype might be freely
- *          changed in future.
- */
-int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
-			 snd_pcm_format_t sformat,
-			 int ctl_card, snd_ctl_elem_id_t *ctl_id,
-			 int cchannels,
-			 double min_dB, double max_dB, int resolution,
-			 snd_pcm_t *slave, int close_slave)
+static int softvol_open(snd_pcm_t **pcmp, const char *name,
+			snd_pcm_format_t sformat,
+			int ctl_card, snd_ctl_elem_id_t *ctl_id,
+			int cchannels,
+			double min_dB, double max_dB, int resolution,
+			int ramp, snd_pcm_t *slave, int close_slave)
 {
 	snd_pcm_t *pcm;
 	snd_pcm_softvol_t *svol;
 	int err;
 	assert(pcmp && slave);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    sformat != SND_PCM_FORMAT_S16_LE &&
-	    sformat != SND_PCM_FORMAT_S16_BE &&
-	    sformat != SND_PCM_FORMAT_S24_3LE && 
-	    sformat != SND_PCM_FORMAT_S32_LE &&
-	    sformat != SND_PCM_FORMAT_S32_BE)
+	    !softvol_format_supported(sformat))
 		return -EINVAL;
 	svol = calloc(1, sizeof(*svol));
 	if (! svol)
@@ -880,10 +1422,12 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_plugin_init(&svol->plug);
 	svol->sformat = sformat;
 	svol->cchannels = cchannels;
+	svol->ramp = ramp;
 	svol->plug.read = snd_pcm_softvol_read_areas;
 	svol->plug.write = snd_pcm_softvol_write_areas;
 	svol->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	svol->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	svol->plug.fuse = 1;
 	svol->plug.gen.slave = slave;
 	svol->plug.gen.close_slave = close_slave;
 
@@ -911,6 +1455,36 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+/**
+ * \brief Creates a new SoftVolume PCM
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param sformat Slave format
+ * \param ctl_card card index of the control
+ * \param ctl_id The control element
+ * \param cchannels PCM channels
+ * \param min_dB minimal dB value
+ * \param max_dB maximal dB value
+ * \param resolution resolution of control
+ * \param slave Slave PCM handle
+ * \param close_slave When set, the slave PCM handle is closed with copy PCM
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
+			 snd_pcm_format_t sformat,
+			 int ctl_card, snd_ctl_elem_id_t *ctl_id,
+			 int cchannels,
+			 double min_dB, double max_dB, int resolution,
+			 snd_pcm_t *slave, int close_slave)
+{
+	return softvol_open(pcmp, name, sformat, ctl_card, ctl_id, cchannels,
+			    min_dB, max_dB, resolution, SOFTVOL_RAMP_NONE,
+			    slave, close_slave);
+}
+
 /* in pcm_misc.c */
 int snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id, int *cardp,
 			     int *cchannelsp, int *hwctlp);
@@ -929,6 +1503,12 @@ If the control already exists and it's a system control (i.e. no
 user-defined control), the plugin simply passes its slave without
 any changes.
 
+By default a volume change takes effect at once.  With the ramp option,
+the gain moves to the new value over one period instead, either in equal
+linear steps or in equal dB steps (exponential), which avoids the clicks
+and zipper noise of abrupt changes.  Exponential ramps from or to mute
+are done linearly.
+
 \code
 pcm.name {
         type softvol            # Soft Volume conversion PCM
@@ -953,6 +1533,8 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp STR]              # volume change ramp: none, linear or
+				# exponential (default: none)
 }
 \endcode
 
@@ -993,6 +1575,7 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	int ramp = SOFTVOL_RAMP_NONE;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1035,6 +1618,25 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "ramp") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid ramp type");
+				return err;
+			}
+			if (strcmp(str, "none") == 0)
+				ramp = SOFTVOL_RAMP_NONE;
+			else if (strcmp(str, "linear") == 0)
+				ramp = SOFTVOL_RAMP_LINEAR;
+			else if (strcmp(str, "exponential") == 0)
+				ramp = SOFTVOL_RAMP_EXPONENTIAL;
+			else {
+				SNDERR("Invalid ramp type %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1073,13 +1675,9 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		if (err < 0)
 			return err;
 		if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-		    sformat != SND_PCM_FORMAT_S16_LE &&
-		    sformat != SND_PCM_FORMAT_S16_BE &&
-		    sformat != SND_PCM_FORMAT_S24_3LE && 
-		    sformat != SND_PCM_FORMAT_S32_LE &&
-		    sformat != SND_PCM_FORMAT_S32_BE) {
-			SNDERR("only S16_LE, S16_BE, S24_3LE, S32_LE or S32_BE format "
-			       "is supported");
+		    !softvol_format_supported(sformat)) {
+			SNDERR("only S16_LE, S16_BE, S24_3LE, S32_LE, S32_BE or FLOAT "
+			       "format is supported");
 			snd_config_delete(sconf);
 			return -EINVAL;
 		}
@@ -1091,8 +1689,8 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			snd_pcm_close(spcm);
 			return err;
 		}
-		err = snd_pcm_softvol_open(pcmp, name, sformat, card, ctl_id, cchannels,
-					   min_dB, max_dB, resolution, spcm, 1);
+		err = softvol_open(pcmp, name, sformat, card, ctl_id, cchannels,
+				   min_dB, max_dB, resolution, ramp, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
 	}
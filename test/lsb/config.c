@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "test.h"
 
 static int configs_equal(snd_config_t *c1, snd_config_t *c2);
@@ -56,6 +59,304 @@ static int configs_equal(snd_config_t *c1, snd_config_t *c2)
 	}
 }
 
+/* creates dir/name with the given contents and returns its path in path */
+static int write_file(const char *dir, const char *name, const char *text,
+		      char *path, size_t size)
+{
+	FILE *f;
+
+	snprintf(path, size, "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	fputs(text, f);
+	return fclose(f) ? -errno : 0;
+}
+
+/* returns the number of the cache entries in dir, the path of the last one in path */
+static int cache_entries(const char *dir, char *path, size_t size)
+{
+	struct dirent *de;
+	DIR *d;
+	int count = 0;
+
+	d = opendir(dir);
+	if (!d)
+		return -errno;
+	while ((de = readdir(d)) != NULL) {
+		size_t len = strlen(de->d_name);
+		if (len > 4 && !strcmp(de->d_name + len - 4, ".bin")) {
+			snprintf(path, size, "%s/%s", dir, de->d_name);
+			count++;
+		}
+	}
+	closedir(d);
+	return count;
+}
+
+static void error_quiet(const char *file, int line, const char *function,
+			int err, const char *fmt, ...)
+{
+}
+
+/* the children of large compounds are found through a hash index */
+static void test_many_children(void)
+{
+	snd_config_t *top, *c;
+	char id[16];
+	long v;
+	int k;
+
+	if (ALSA_CHECK(snd_config_top(&top)) < 0)
+		return;
+	for (k = 0; k < 200; k++) {
+		snprintf(id, sizeof(id), "n%d", k);
+		ALSA_CHECK(snd_config_imake_integer(&c, id, k));
+		ALSA_CHECK(snd_config_add(top, c));
+	}
+	ALSA_CHECK(snd_config_imake_integer(&c, "n7", 0));
+	TEST_CHECK(snd_config_add(top, c) == -EEXIST);
+	snd_config_delete(c);
+	for (k = 0; k < 200; k++) {
+		snprintf(id, sizeof(id), "n%d", k);
+		TEST_CHECK(snd_config_search(top, id, &c) >= 0 &&
+			   snd_config_get_integer(c, &v) >= 0 && v == k);
+	}
+	/* a prefix or an extension of an id must not match */
+	TEST_CHECK(snd_config_search(top, "n", &c) == -ENOENT);
+	TEST_CHECK(snd_config_search(top, "n1999", &c) == -ENOENT);
+
+	for (k = 0; k < 200; k += 2) {
+		snprintf(id, sizeof(id), "n%d", k);
+		if (ALSA_CHECK(snd_config_search(top, id, &c)) >= 0)
+			ALSA_CHECK(snd_config_delete(c));
+	}
+	for (k = 0; k < 200; k++) {
+		snprintf(id, sizeof(id), "n%d", k);
+		TEST_CHECK((snd_config_search(top, id, &c) >= 0) == (k & 1));
+	}
+
+	ALSA_CHECK(snd_config_search(top, "n1", &c));
+	TEST_CHECK(snd_config_set_id(c, "n3") == -EEXIST);
+	ALSA_CHECK(snd_config_set_id(c, "renamed"));
+	TEST_CHECK(snd_config_search(top, "n1", &c) == -ENOENT);
+	TEST_CHECK(snd_config_search(top, "renamed", &c) >= 0 &&
+		   snd_config_get_integer(c, &v) >= 0 && v == 1);
+	ALSA_CHECK(snd_config_set_id(c, "n0"));
+	TEST_CHECK(snd_config_search(top, "renamed", &c) == -ENOENT);
+	TEST_CHECK(snd_config_search(top, "n0", &c) >= 0 &&
+		   snd_config_get_integer(c, &v) >= 0 && v == 1);
+
+	ALSA_CHECK(snd_config_delete(top));
+}
+
+/* the files parsed by several threads and merged give the same tree as
+ * parsing them one after another */
+static void test_parallel(void)
+{
+	static const char *const texts[] = {
+		"a 1\nb { c 'x' d [ 1 2 ] }\ns.t.u 5\n",
+		"a 2\nb.e 'y'\nb.d.2 3\nl [ p q r ]\n",
+		"!b { f 6 }\ng { h 7 }\n",
+		"?a 9\ng.i 'z'\ns.t.v 8\n",
+		"s { t { u 10 } }\nm 'last'\n",
+	};
+	char dir[] = "/tmp/alsa-config-threads-XXXXXX";
+	char paths[5][PATH_MAX], list[5 * PATH_MAX + 5];
+	snd_config_t *sequential = NULL, *parallel = NULL;
+	snd_config_update_t *update;
+	unsigned int k;
+
+	if (!mkdtemp(dir)) {
+		TEST_CHECK(0);
+		return;
+	}
+	list[0] = '\0';
+	for (k = 0; k < 5; k++) {
+		char name[16];
+		snprintf(name, sizeof(name), "%u.conf", k);
+		ALSA_CHECK(write_file(dir, name, texts[k], paths[k], sizeof(paths[k])));
+		if (k)
+			strcat(list, ":");
+		strcat(list, paths[k]);
+	}
+
+	unsetenv("ALSA_CONFIG_THREADS");
+	update = NULL;
+	ALSA_CHECK(snd_config_update_r(&sequential, &update, list));
+	snd_config_update_free(update);
+	setenv("ALSA_CONFIG_THREADS", "4", 1);
+	update = NULL;
+	ALSA_CHECK(snd_config_update_r(&parallel, &update, list));
+	snd_config_update_free(update);
+	unsetenv("ALSA_CONFIG_THREADS");
+
+	TEST_CHECK(sequential && parallel && configs_equal(sequential, parallel));
+	if (sequential)
+		snd_config_delete(sequential);
+	if (parallel)
+		snd_config_delete(parallel);
+	for (k = 0; k < 5; k++)
+		unlink(paths[k]);
+	rmdir(dir);
+}
+
+/* returns the string value of id in the expansion of the definition name
+ * in the global tree, or NULL */
+static char *expand_string(const char *name, const char *id)
+{
+	snd_config_t *res, *c;
+	const char *str;
+	char *value = NULL;
+
+	if (ALSA_CHECK(snd_config_search_definition(snd_config, NULL, name, &res)) < 0)
+		return NULL;
+	if (snd_config_search(res, id, &c) >= 0 &&
+	    snd_config_get_string(c, &str) >= 0)
+		value = strdup(str);
+	snd_config_delete(res);
+	return value;
+}
+
+static int expand_string_is(const char *name, const char *id, const char *expected)
+{
+	char *value = expand_string(name, id);
+	int ok = value && !strcmp(value, expected);
+
+	free(value);
+	return ok;
+}
+
+/* the expansions from the global tree are remembered until the tree or
+ * the environment they read changes */
+static void test_memo(void)
+{
+	char dir[] = "/tmp/alsa-config-memo-XXXXXX";
+	char path[PATH_MAX], tmp[PATH_MAX];
+	const char *text =
+		"memo_test {\n"
+		"	env { @func getenv vars [ ALSA_MEMO_TEST ] default unset }\n"
+		"	file %s\n"
+		"}\n";
+	char buf[256];
+	char *saved_path = getenv("ALSA_CONFIG_PATH");
+
+	if (!mkdtemp(dir)) {
+		TEST_CHECK(0);
+		return;
+	}
+	if (saved_path)
+		saved_path = strdup(saved_path);
+	snprintf(buf, sizeof(buf), text, "first");
+	ALSA_CHECK(write_file(dir, "memo.conf", buf, path, sizeof(path)));
+	setenv("ALSA_CONFIG_PATH", path, 1);
+	unsetenv("ALSA_MEMO_TEST");
+	ALSA_CHECK(snd_config_update());
+
+	TEST_CHECK(expand_string_is("memo_test", "env", "unset"));
+	TEST_CHECK(expand_string_is("memo_test", "env", "unset"));
+	setenv("ALSA_MEMO_TEST", "one", 1);
+	TEST_CHECK(expand_string_is("memo_test", "env", "one"));
+	TEST_CHECK(expand_string_is("memo_test", "env", "one"));
+	setenv("ALSA_MEMO_TEST", "two", 1);
+	TEST_CHECK(expand_string_is("memo_test", "env", "two"));
+	unsetenv("ALSA_MEMO_TEST");
+	TEST_CHECK(expand_string_is("memo_test", "env", "unset"));
+	TEST_CHECK(expand_string_is("memo_test", "file", "first"));
+
+	/* a new file is a new generation of the global tree */
+	snprintf(buf, sizeof(buf), text, "second");
+	ALSA_CHECK(write_file(dir, "memo.tmp", buf, tmp, sizeof(tmp)));
+	TEST_CHECK(rename(tmp, path) == 0);
+	TEST_CHECK(snd_config_update() == 1);
+	TEST_CHECK(expand_string_is("memo_test", "file", "second"));
+
+	snd_config_update_free_global();
+	if (saved_path) {
+		setenv("ALSA_CONFIG_PATH", saved_path, 1);
+		free(saved_path);
+	} else {
+		unsetenv("ALSA_CONFIG_PATH");
+	}
+	unlink(path);
+	rmdir(dir);
+}
+
+static void test_cache(void)
+{
+	const char *text_a =
+		"a 1\n"
+		"b { c 'x y' d [ 1 2 3 ] }\n";
+	char dir[] = "/tmp/alsa-config-cache-XXXXXX";
+	char path_a[PATH_MAX], path_b[PATH_MAX], entry[PATH_MAX], text_b[PATH_MAX + 64];
+	snd_config_t *parsed, *cached;
+	snd_config_update_t *update;
+	snd_input_t *input;
+	FILE *f;
+
+	if (!mkdtemp(dir)) {
+		TEST_CHECK(0);
+		return;
+	}
+	ALSA_CHECK(write_file(dir, "a.conf", text_a, path_a, sizeof(path_a)));
+	snprintf(text_b, sizeof(text_b), "<%s>\nb.e 4\nf.g 'h'\n", path_a);
+	ALSA_CHECK(write_file(dir, "b.conf", text_b, path_b, sizeof(path_b)));
+
+	/* the reference tree, parsed without a cache */
+	ALSA_CHECK(snd_config_top(&parsed));
+	ALSA_CHECK(snd_input_buffer_open(&input, text_a, -1));
+	ALSA_CHECK(snd_config_load(parsed, input));
+	ALSA_CHECK(snd_input_close(input));
+	ALSA_CHECK(snd_input_buffer_open(&input, text_b + strlen(path_a) + 3, -1));
+	ALSA_CHECK(snd_config_load(parsed, input));
+	ALSA_CHECK(snd_input_close(input));
+
+	setenv("ALSA_CONFIG_CACHE", dir, 1);
+
+	/* the first load parses the text and saves the entry, the second
+	 * one replays it */
+	cached = NULL;
+	update = NULL;
+	ALSA_CHECK(snd_config_update_r(&cached, &update, path_b));
+	TEST_CHECK(cached && configs_equal(parsed, cached));
+	snd_config_delete(cached);
+	snd_config_update_free(update);
+	TEST_CHECK(cache_entries(dir, entry, sizeof(entry)) == 1);
+	cached = NULL;
+	update = NULL;
+	ALSA_CHECK(snd_config_update_r(&cached, &update, path_b));
+	TEST_CHECK(cached && configs_equal(parsed, cached));
+	snd_config_delete(cached);
+	snd_config_update_free(update);
+
+	/* unterminated compounds instead of the last value fail to
+	 * replay, the text is parsed again into the untouched tree */
+	f = fopen(entry, "r+");
+	TEST_CHECK(f != NULL);
+	if (f) {
+		fseek(f, -6, SEEK_END);
+		fputs("{{{{{{", f);
+		fclose(f);
+	}
+	cached = NULL;
+	update = NULL;
+	snd_lib_error_set_handler(error_quiet);
+	ALSA_CHECK(snd_config_update_r(&cached, &update, path_b));
+	snd_lib_error_set_handler(NULL);
+	TEST_CHECK(cached && configs_equal(parsed, cached));
+	snd_config_delete(cached);
+	snd_config_update_free(update);
+	/* the broken entry was replaced */
+	TEST_CHECK(cache_entries(dir, entry, sizeof(entry)) == 1);
+
+	unsetenv("ALSA_CONFIG_CACHE");
+	snd_config_delete(parsed);
+	unlink(entry);
+	unlink(path_a);
+	unlink(path_b);
+	rmdir(dir);
+}
+
 static void test_top(void)
 {
 	snd_config_t *top;
@@ -578,5 +879,9 @@ int main(void)
 	test_get_ascii();
 	test_iterators();
 	test_for_each();
+	test_many_children();
+	test_cache();
+	test_memo();
+	test_parallel();
 	return TEST_EXIT_CODE();
 }
@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+#include <alsa/pcm_external.h>
+#include <alsa/pcm_plugin.h>
+
+/*
+ * A playback sink which records what it gets; the second transfer is
+ * refused, so the commit which follows a partial one is short.
+ */
+
+#define CHANNELS	2
+#define BUFFER_SIZE	4096
+#define RECORD_SIZE	(64 * 1024)
+
+struct sink {
+	snd_pcm_ioplug_t io;
+	snd_pcm_uframes_t hw_ptr;
+	int transfers;
+	snd_pcm_uframes_t partial;
+	short record[RECORD_SIZE * CHANNELS];
+	snd_pcm_uframes_t recorded;
+};
+
+static int sink_start(snd_pcm_ioplug_t *io)
+{
+	return 0;
+}
+
+static int sink_stop(snd_pcm_ioplug_t *io)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t sink_pointer(snd_pcm_ioplug_t *io)
+{
+	struct sink *sink = io->private_data;
+
+	return sink->hw_ptr % io->buffer_size;
+}
+
+static snd_pcm_sframes_t sink_transfer(snd_pcm_ioplug_t *io,
+				       const snd_pcm_channel_area_t *areas,
+				       snd_pcm_uframes_t offset,
+				       snd_pcm_uframes_t size)
+{
+	struct sink *sink = io->private_data;
+	snd_pcm_uframes_t i;
+	unsigned int ch;
+
+	switch (sink->transfers++) {
+	case 0:
+		if (sink->partial && size > sink->partial)
+			size = sink->partial;
+		break;
+	case 1:
+		if (sink->partial)
+			return -EAGAIN;
+		break;
+	}
+	for (i = 0; i < size && sink->recorded < RECORD_SIZE; i++) {
+		for (ch = 0; ch < CHANNELS; ch++) {
+			const snd_pcm_channel_area_t *a = &areas[ch];
+			const char *p = a->addr;
+
+			p += (a->first + (offset + i) * a->step) / 8;
+			sink->record[sink->recorded * CHANNELS + ch] = *(const short *)p;
+		}
+		sink->recorded++;
+	}
+	sink->hw_ptr += size;
+	return size;
+}
+
+static const snd_pcm_ioplug_callback_t sink_callback = {
+	.start = sink_start,
+	.stop = sink_stop,
+	.pointer = sink_pointer,
+	.transfer = sink_transfer,
+};
+
+static int sink_open(snd_pcm_t **pcmp, struct sink *sink)
+{
+	static const unsigned int access[] = {
+		SND_PCM_ACCESS_MMAP_INTERLEAVED,
+	};
+	static const unsigned int format[] = {
+		SND_PCM_FORMAT_S16,
+	};
+	int err;
+
+	memset(sink, 0, sizeof(*sink));
+	sink->io.version = SND_PCM_IOPLUG_VERSION;
+	sink->io.name = "partial commit sink";
+	sink->io.callback = &sink_callback;
+	sink->io.private_data = sink;
+	err = snd_pcm_ioplug_create(&sink->io, "sink", SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0)
+		return err;
+	snd_pcm_ioplug_set_param_list(&sink->io, SND_PCM_IOPLUG_HW_ACCESS, 1, access);
+	snd_pcm_ioplug_set_param_list(&sink->io, SND_PCM_IOPLUG_HW_FORMAT, 1, format);
+	snd_pcm_ioplug_set_param_minmax(&sink->io, SND_PCM_IOPLUG_HW_CHANNELS,
+					CHANNELS, CHANNELS);
+	*pcmp = sink->io.pcm;
+	return 0;
+}
+
+/*
+ * S16 -> S32 -> S16 through two linear plugins, which are fused, so the
+ * sink must get the written samples exactly once and in order
+ */
+static void test_partial_commit(snd_pcm_uframes_t partial)
+{
+	static struct sink sink;
+	snd_pcm_t *pcm, *mid, *slave;
+	snd_pcm_uframes_t frames = 3000, done = 0, i;
+	short *samples;
+
+	if (ALSA_CHECK(sink_open(&slave, &sink)) < 0)
+		return;
+	sink.partial = partial;
+	if (ALSA_CHECK(snd_pcm_linear_open(&mid, "mid", SND_PCM_FORMAT_S16,
+					   slave, 1)) < 0) {
+		snd_pcm_close(slave);
+		return;
+	}
+	if (ALSA_CHECK(snd_pcm_linear_open(&pcm, "top", SND_PCM_FORMAT_S32,
+					   mid, 1)) < 0) {
+		snd_pcm_close(mid);
+		return;
+	}
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16,
+					  SND_PCM_ACCESS_MMAP_INTERLEAVED,
+					  CHANNELS, 48000, 0, 100000)) < 0)
+		goto _close;
+	samples = malloc(frames * CHANNELS * sizeof(short));
+	if (!samples)
+		goto _close;
+	for (i = 0; i < frames * CHANNELS; i++)
+		samples[i] = i * 7;
+	while (done < frames) {
+		snd_pcm_sframes_t r = snd_pcm_mmap_writei(pcm, samples + done * CHANNELS,
+							  frames - done);
+		if (r == -EAGAIN)
+			continue;
+		if (ALSA_CHECK(r) < 0)
+			break;
+		done += r;
+	}
+	TEST_CHECK(sink.recorded == frames);
+	TEST_CHECK(!memcmp(sink.record, samples,
+			   sink.recorded * CHANNELS * sizeof(short)));
+	free(samples);
+ _close:
+	snd_pcm_close(pcm);
+}
+
+int main(void)
+{
+	test_partial_commit(0);
+	test_partial_commit(100);
+	return TEST_EXIT_CODE();
+}
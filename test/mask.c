@@ -0,0 +1,272 @@
+/*
+ *  Microbenchmark of the hw_params mask inlines
+ *
+ *  The word-parallel implementations in src/pcm/mask_inline.h are
+ *  checked and timed against the former bit loop versions, which are
+ *  kept here as the reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/types.h>
+
+struct _snd_mask {
+	u_int32_t bits[8];
+};
+typedef struct _snd_mask snd_mask_t;
+#define SND_MASK_MAX 64
+
+#include "../src/pcm/mask_inline.h"
+
+#define NMASKS	1024
+
+static unsigned int old_ld2(u_int32_t v)
+{
+	unsigned r = 0;
+
+	if (v >= 0x10000) {
+		v >>= 16;
+		r += 16;
+	}
+	if (v >= 0x100) {
+		v >>= 8;
+		r += 8;
+	}
+	if (v >= 0x10) {
+		v >>= 4;
+		r += 4;
+	}
+	if (v >= 4) {
+		v >>= 2;
+		r += 2;
+	}
+	if (v >= 2)
+		r++;
+	return r;
+}
+
+static unsigned int old_hweight32(u_int32_t v)
+{
+	v = (v & 0x55555555) + ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	v = (v & 0x0F0F0F0F) + ((v >> 4) & 0x0F0F0F0F);
+	v = (v & 0x00FF00FF) + ((v >> 8) & 0x00FF00FF);
+	return (v & 0x0000FFFF) + ((v >> 16) & 0x0000FFFF);
+}
+
+static int old_empty(const snd_mask_t *mask)
+{
+	int i;
+	for (i = 0; i < MASK_SIZE; i++)
+		if (mask->bits[i])
+			return 0;
+	return 1;
+}
+
+static unsigned int old_count(const snd_mask_t *mask)
+{
+	int i, w = 0;
+	for (i = 0; i < MASK_SIZE; i++)
+		w += old_hweight32(mask->bits[i]);
+	return w;
+}
+
+static unsigned int old_min(const snd_mask_t *mask)
+{
+	int i;
+	assert(!old_empty(mask));
+	for (i = 0; i < MASK_SIZE; i++) {
+		if (mask->bits[i])
+			return ffs(mask->bits[i]) - 1 + (i << 5);
+	}
+	return 0;
+}
+
+static unsigned int old_max(const snd_mask_t *mask)
+{
+	int i;
+	assert(!old_empty(mask));
+	for (i = MASK_SIZE - 1; i >= 0; i--) {
+		if (mask->bits[i])
+			return old_ld2(mask->bits[i]) + (i << 5);
+	}
+	return 0;
+}
+
+static void old_reset_range(snd_mask_t *mask, unsigned int from, unsigned int to)
+{
+	unsigned int i;
+	assert(to <= SND_MASK_MAX && from <= to);
+	for (i = from; i <= to; i++)
+		mask->bits[MASK_OFS(i)] &= ~MASK_BIT(i);
+}
+
+static int old_single(const snd_mask_t *mask)
+{
+	int i, c = 0;
+	assert(!old_empty(mask));
+	for (i = 0; i < MASK_SIZE; i++) {
+		if (! mask->bits[i])
+			continue;
+		if (mask->bits[i] & (mask->bits[i] - 1))
+			return 0;
+		if (c)
+			return 0;
+		c++;
+	}
+	return 1;
+}
+
+static int old_refine(snd_mask_t *mask, const snd_mask_t *v)
+{
+	snd_mask_t old;
+	int i;
+	if (old_empty(mask))
+		return -ENOENT;
+	old = *mask;
+	for (i = 0; i < MASK_SIZE; i++)
+		mask->bits[i] &= v->bits[i];
+	if (old_empty(mask))
+		return -EINVAL;
+	return !!memcmp(mask, &old, MASK_SIZE * 4);
+}
+
+static int old_refine_min(snd_mask_t *mask, unsigned int val)
+{
+	if (old_empty(mask))
+		return -ENOENT;
+	if (old_min(mask) >= val)
+		return 0;
+	old_reset_range(mask, 0, val - 1);
+	if (old_empty(mask))
+		return -EINVAL;
+	return 1;
+}
+
+static int old_refine_max(snd_mask_t *mask, unsigned int val)
+{
+	if (old_empty(mask))
+		return -ENOENT;
+	if (old_max(mask) <= val)
+		return 0;
+	old_reset_range(mask, val + 1, SND_MASK_MAX);
+	if (old_empty(mask))
+		return -EINVAL;
+	return 1;
+}
+
+static snd_mask_t masks[NMASKS];
+static unsigned int vals[NMASKS];
+
+static u_int32_t rnd32(void)
+{
+	return ((u_int32_t)rand() << 16) ^ (u_int32_t)rand();
+}
+
+static void init(void)
+{
+	int k;
+
+	srand(1);
+	for (k = 0; k < NMASKS; k++) {
+		memset(&masks[k], 0, sizeof(masks[k]));
+		/* sparse masks, as the format and access masks usually are */
+		masks[k].bits[0] = rnd32() & rnd32() & rnd32();
+		masks[k].bits[1] = (k & 1) ? rnd32() & rnd32() : 0;
+		if (!masks[k].bits[0] && !masks[k].bits[1])
+			masks[k].bits[0] = 1U << (k & 31);
+		vals[k] = rand() % SND_MASK_MAX;
+	}
+}
+
+static int check(void)
+{
+	snd_mask_t a, b;
+	int k, errors = 0;
+
+	for (k = 0; k < NMASKS; k++) {
+		const snd_mask_t *m = &masks[k], *n = &masks[(k + 1) % NMASKS];
+		int r1, r2;
+
+		if (old_count(m) != snd_mask_count(m) ||
+		    old_min(m) != snd_mask_min(m) ||
+		    old_max(m) != snd_mask_max(m) ||
+		    old_single(m) != snd_mask_single(m))
+			errors++;
+		a = b = *m;
+		r1 = old_refine(&a, n);
+		r2 = snd_mask_refine(&b, n);
+		if (r1 != r2 || memcmp(&a, &b, sizeof(a)))
+			errors++;
+		a = b = *m;
+		r1 = old_refine_min(&a, vals[k]);
+		r2 = snd_mask_refine_min(&b, vals[k]);
+		if (r1 != r2 || memcmp(&a, &b, sizeof(a)))
+			errors++;
+		a = b = *m;
+		r1 = old_refine_max(&a, vals[k]);
+		r2 = snd_mask_refine_max(&b, vals[k]);
+		if (r1 != r2 || memcmp(&a, &b, sizeof(a)))
+			errors++;
+	}
+	return errors;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile unsigned int sink;
+
+#define BENCH(name, expr) do { \
+	double t = now(); \
+	unsigned int acc = 0; \
+	int l, k; \
+	for (l = 0; l < loops; l++) \
+		for (k = 0; k < NMASKS; k++) { \
+			snd_mask_t tmp = masks[k]; \
+			acc += (expr); \
+		} \
+	sink = acc; \
+	printf("  %-24s %8.2f ns\n", name, \
+	       (now() - t) * 1e9 / ((double)loops * NMASKS)); \
+} while (0)
+
+int main(int argc, char **argv)
+{
+	int loops = argc > 1 ? atoi(argv[1]) : 2000;
+	int errors;
+
+	init();
+	errors = check();
+	if (errors) {
+		printf("%d mismatches against the reference implementation\n", errors);
+		return EXIT_FAILURE;
+	}
+
+	printf("reference:\n");
+	BENCH("count", old_count(&tmp));
+	BENCH("min + max", old_min(&tmp) + old_max(&tmp));
+	BENCH("single", old_single(&tmp));
+	BENCH("refine", old_refine(&tmp, &masks[(k + 1) % NMASKS]));
+	BENCH("refine_min", old_refine_min(&tmp, vals[k]));
+	BENCH("refine_max", old_refine_max(&tmp, vals[k]));
+
+	printf("mask_inline.h:\n");
+	BENCH("count", snd_mask_count(&tmp));
+	BENCH("min + max", snd_mask_min(&tmp) + snd_mask_max(&tmp));
+	BENCH("single", snd_mask_single(&tmp));
+	BENCH("refine", snd_mask_refine(&tmp, &masks[(k + 1) % NMASKS]));
+	BENCH("refine_min", snd_mask_refine_min(&tmp, vals[k]));
+	BENCH("refine_max", snd_mask_refine_max(&tmp, vals[k]));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+/*
+ *  PCM plugin chain benchmark
+ *
+ *  Pushes audio through chains of the standard plugins which end in
+ *  the null PCM (or another sink which does not need a sound card) and
+ *  reports the throughput and the cost per frame of every chain.  The
+ *  null chain is the baseline, the difference to it is the cost of the
+ *  plugins themselves.  Chains which cannot be opened on this machine
+ *  (softvol, dmix and ladspa need a card or plugins) are skipped.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+#define NULL_SLAVE	"{ type null }"
+
+struct chain {
+	const char *name;
+	const char *conf;	/* body of the pcm definition */
+};
+
+static const struct chain chains[] = {
+	{ "null", "type null" },
+	{ "file", "type file file \"/dev/null\" format raw slave.pcm " NULL_SLAVE },
+	{ "linear", "type linear slave { pcm " NULL_SLAVE " format S32_LE }" },
+	{ "lfloat", "type lfloat slave { pcm " NULL_SLAVE " format FLOAT_LE }" },
+	{ "route", "type route slave { pcm " NULL_SLAVE " channels 2 } "
+		  "ttable { 0 { 0 0.5 1 0.5 } 1 { 0 0.5 1 0.5 } }" },
+	{ "rate-linear", "type rate converter \"linear\" "
+			 "slave { pcm " NULL_SLAVE " rate 48000 }" },
+	{ "rate-sinc_fast", "type rate converter \"sinc_fast\" "
+			    "slave { pcm " NULL_SLAVE " rate 48000 }" },
+	{ "rate-sinc", "type rate converter \"sinc\" "
+		       "slave { pcm " NULL_SLAVE " rate 48000 }" },
+	{ "plug", "type plug slave { pcm " NULL_SLAVE
+		  " format FLOAT_LE rate 48000 channels 4 }" },
+	{ "linear+route", "type linear slave { pcm { type route slave { pcm "
+			  NULL_SLAVE " channels 2 } ttable { 0 { 0 0.5 1 0.5 } "
+			  "1 { 0 0.5 1 0.5 } } } format S32_LE }" },
+	{ "softvol", "type softvol slave.pcm " NULL_SLAVE
+		     " control { name \"PCM Bench Volume\" card 0 }" },
+	{ "dmix", "type dmix ipc_key 5678293 ipc_key_add_uid yes "
+		  "slave.pcm \"hw:0\"" },
+	{ "ladspa", "type ladspa slave.pcm " NULL_SLAVE
+		    " plugins [ { label amp_stereo input.controls [ 0.5 ] } ]" },
+};
+
+#define NCHAINS	(sizeof(chains) / sizeof(chains[0]))
+
+static snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
+static unsigned int channels = 2;
+static unsigned int rate = 44100;
+static snd_pcm_uframes_t period = 1024;
+static unsigned long frames = 1000000;
+static int repeats = 3;
+
+static double timespec_sec(const struct timespec *ts)
+{
+	return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+static int open_chain(snd_pcm_t **pcmp, const struct chain *chain)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	char *buf;
+	int err;
+
+	buf = malloc(strlen(chain->conf) + 32);
+	if (buf == NULL)
+		return -ENOMEM;
+	sprintf(buf, "pcm.bench { %s }", chain->conf);
+	err = snd_config_top(&top);
+	if (err < 0)
+		goto _free;
+	err = snd_input_buffer_open(&in, buf, -1);
+	if (err < 0)
+		goto _delete;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcmp, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+ _delete:
+	snd_config_delete(top);
+ _free:
+	free(buf);
+	return err;
+}
+
+/*
+ * run one pass of the benchmark, returns the wall clock and the CPU
+ * time spent in seconds
+ */
+static int run(snd_pcm_t *pcm, const void *buffer, double *wall, double *cpu)
+{
+	struct timespec w0, w1, c0, c1;
+	unsigned long done = 0;
+	snd_pcm_sframes_t r;
+
+	clock_gettime(CLOCK_MONOTONIC, &w0);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c0);
+	while (done < frames) {
+		r = snd_pcm_writei(pcm, buffer, period);
+		if (r < 0) {
+			r = snd_pcm_recover(pcm, r, 1);
+			if (r < 0)
+				return r;
+			continue;
+		}
+		done += r;
+	}
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c1);
+	clock_gettime(CLOCK_MONOTONIC, &w1);
+	*wall = timespec_sec(&w1) - timespec_sec(&w0);
+	*cpu = timespec_sec(&c1) - timespec_sec(&c0);
+	return 0;
+}
+
+static int bench(snd_pcm_t *pcm, const char *name, double *baseline)
+{
+	double wall, cpu, best_wall = 0, best_cpu = 0, ns;
+	unsigned char *buffer;
+	size_t bytes;
+	unsigned int seed = 1;
+	int k, err;
+
+	err = snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+				 channels, rate, 1, 500000);
+	if (err < 0) {
+		printf("%-16s skipped: %s\n", name, snd_strerror(err));
+		return err;
+	}
+	bytes = snd_pcm_frames_to_bytes(pcm, period);
+	buffer = malloc(bytes);
+	if (buffer == NULL)
+		return -ENOMEM;
+	for (k = 0; k < (int)bytes; k++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[k] = seed >> 16;
+	}
+	/* warm up the caches and the lazily allocated plugin state */
+	snd_pcm_writei(pcm, buffer, period);
+	for (k = 0; k < repeats; k++) {
+		err = run(pcm, buffer, &wall, &cpu);
+		if (err < 0) {
+			printf("%-16s failed: %s\n", name, snd_strerror(err));
+			free(buffer);
+			return err;
+		}
+		if (k == 0 || cpu < best_cpu) {
+			best_cpu = cpu;
+			best_wall = wall;
+		}
+	}
+	free(buffer);
+	ns = best_cpu * 1e9 / frames;
+	printf("%-16s %12.0f %10.2f %10.2f", name, frames / best_wall,
+	       best_wall * 1e9 / frames, ns);
+	if (baseline == NULL)
+		putchar('\n');
+	else if (*baseline < 0)
+		printf(" %10s\n", "-");
+	else
+		printf(" %+10.2f\n", ns - *baseline);
+	if (baseline && *baseline < 0)
+		*baseline = ns;
+	return 0;
+}
+
+static void help(void)
+{
+	unsigned int k;
+
+	printf(
+"Usage: pcm_bench [OPTION]... [CHAIN]...\n"
+"-h,--help      help\n"
+"-l,--list      list the chains\n"
+"-D,--device    benchmark a PCM of the global configuration instead\n"
+"-f,--format    sample format (S16_LE)\n"
+"-c,--channels  channels (2)\n"
+"-r,--rate      rate (44100)\n"
+"-p,--period    frames per write (1024)\n"
+"-n,--frames    frames per pass (1000000)\n"
+"-R,--repeat    passes per chain, the best one is reported (3)\n"
+"\n"
+"Without CHAIN arguments all chains are measured, the null chain is\n"
+"always measured as the baseline.  The columns are the\n"
+"frames per second and the wall clock and CPU nanoseconds per frame of\n"
+"the best pass, and the CPU time per frame above the null chain.  For\n"
+"sinks paced by a sound card only the CPU time is meaningful.\n"
+"\n"
+"Chains:");
+	for (k = 0; k < NCHAINS; k++)
+		printf(" %s", chains[k].name);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"list", 0, NULL, 'l'},
+		{"device", 1, NULL, 'D'},
+		{"format", 1, NULL, 'f'},
+		{"channels", 1, NULL, 'c'},
+		{"rate", 1, NULL, 'r'},
+		{"period", 1, NULL, 'p'},
+		{"frames", 1, NULL, 'n'},
+		{"repeat", 1, NULL, 'R'},
+		{NULL, 0, NULL, 0},
+	};
+	const char *device = NULL;
+	double baseline = -1;
+	snd_pcm_t *pcm;
+	unsigned int k;
+	int c, i, err, failed = 0;
+
+	while ((c = getopt_long(argc, argv, "hlD:f:c:r:p:n:R:", long_option, NULL)) >= 0) {
+		switch (c) {
+		case 'h':
+			help();
+			return 0;
+		case 'l':
+			for (k = 0; k < NCHAINS; k++)
+				printf("%-16s %s\n", chains[k].name, chains[k].conf);
+			return 0;
+		case 'D':
+			device = optarg;
+			break;
+		case 'f':
+			format = snd_pcm_format_value(optarg);
+			if (format == SND_PCM_FORMAT_UNKNOWN) {
+				fprintf(stderr, "Unknown format %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'p':
+			period = atoi(optarg);
+			break;
+		case 'n':
+			frames = atol(optarg);
+			break;
+		case 'R':
+			repeats = atoi(optarg);
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+	if (channels < 1 || rate < 1 || period < 1 || frames < 1 || repeats < 1) {
+		fprintf(stderr, "Invalid parameters\n");
+		return 1;
+	}
+
+	printf("%s, %u channels, %u Hz, %lu frames per write\n\n",
+	       snd_pcm_format_name(format), channels, rate, period);
+	printf("%-16s %12s %10s %10s %10s\n", "chain", "frames/s",
+	       "ns/frame", "cpu ns", "vs null");
+
+	if (device) {
+		err = snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
+		if (err < 0) {
+			printf("%-16s skipped: %s\n", device, snd_strerror(err));
+			return 1;
+		}
+		err = bench(pcm, device, NULL);
+		snd_pcm_close(pcm);
+		return err < 0;
+	}
+
+	for (k = 0; k < NCHAINS; k++) {
+		if (optind < argc) {
+			for (i = optind; i < argc; i++)
+				if (!strcmp(argv[i], chains[k].name))
+					break;
+			if (i == argc && k > 0)
+				continue;
+		}
+		err = open_chain(&pcm, &chains[k]);
+		if (err < 0) {
+			printf("%-16s skipped: %s\n", chains[k].name, snd_strerror(err));
+			continue;
+		}
+		if (bench(pcm, chains[k].name, &baseline) < 0)
+			failed++;
+		snd_pcm_close(pcm);
+	}
+	return failed ? 1 : 0;
+}